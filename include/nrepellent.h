@@ -0,0 +1,124 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef NREPELLENT_H
+#define NREPELLENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef NREPELLENT_SHARED_BUILD
+#ifdef _WIN32
+#define NREPELLENT_API __declspec(dllexport)
+#else
+#define NREPELLENT_API __attribute__((visibility("default")))
+#endif
+#else
+#define NREPELLENT_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * noise-repellent without a plugin host. Every handle denoises one channel,
+ * so a stereo stream takes two of them loaded with the same parameters.
+ * Processing never allocates and accepts blocks of any size.
+ *
+ * NoiseRepellent reduces a learned noise profile, optionally following the
+ * drift of its level. NoiseRepellentAdaptive estimates the noise on its own
+ * and keeps the last input seen as a seed to converge again after a reload.
+ * The seed can be read while another thread processes the stream.
+ */
+typedef struct NoiseRepellent NoiseRepellent;
+typedef struct NoiseRepellentAdaptive NoiseRepellentAdaptive;
+
+#define NREPELLENT_LEARN_OFF 0
+#define NREPELLENT_LEARN_AVERAGE 1
+#define NREPELLENT_LEARN_MEDIAN 2
+
+// Same ranges as the plugin ports. The adaptive denoiser ignores the
+// learning, reset, tracking and transient fields.
+typedef struct NoiseRepellentParameters {
+  bool enable;
+  int learn_noise;
+  bool reset_noise_profile;
+  bool noise_tracking;
+  bool residual_listen;
+  bool transient_protection;
+  int noise_scaling_type;
+  float reduction_amount;
+  float noise_rescale;
+  float smoothing_factor;
+  float whitening_factor;
+  float post_filter_threshold;
+} NoiseRepellentParameters;
+
+NREPELLENT_API NoiseRepellent *nrepellent_initialize(uint32_t sample_rate);
+NREPELLENT_API void nrepellent_free(NoiseRepellent *self);
+NREPELLENT_API uint32_t nrepellent_get_latency(const NoiseRepellent *self);
+NREPELLENT_API void
+nrepellent_load_parameters(NoiseRepellent *self,
+                           NoiseRepellentParameters parameters);
+NREPELLENT_API void nrepellent_process(NoiseRepellent *self,
+                                       uint32_t number_of_samples,
+                                       const float *input, float *output);
+NREPELLENT_API uint32_t
+nrepellent_get_noise_profile_size(const NoiseRepellent *self);
+NREPELLENT_API bool nrepellent_noise_profile_available(NoiseRepellent *self);
+NREPELLENT_API bool nrepellent_get_noise_profile(NoiseRepellent *self,
+                                                 float *profile,
+                                                 uint32_t *averaged_blocks,
+                                                 float *noise_floor);
+NREPELLENT_API bool nrepellent_load_noise_profile(NoiseRepellent *self,
+                                                  const float *profile,
+                                                  uint32_t profile_size,
+                                                  uint32_t averaged_blocks,
+                                                  float noise_floor);
+
+NREPELLENT_API NoiseRepellentAdaptive *
+nrepellent_adaptive_initialize(uint32_t sample_rate);
+NREPELLENT_API void nrepellent_adaptive_free(NoiseRepellentAdaptive *self);
+NREPELLENT_API uint32_t
+nrepellent_adaptive_get_latency(const NoiseRepellentAdaptive *self);
+NREPELLENT_API void
+nrepellent_adaptive_load_parameters(NoiseRepellentAdaptive *self,
+                                    NoiseRepellentParameters parameters);
+NREPELLENT_API void nrepellent_adaptive_process(NoiseRepellentAdaptive *self,
+                                                uint32_t number_of_samples,
+                                                const float *input,
+                                                float *output);
+NREPELLENT_API const float *
+nrepellent_adaptive_get_noise_seed(NoiseRepellentAdaptive *self,
+                                   uint32_t *number_of_samples);
+NREPELLENT_API bool
+nrepellent_adaptive_load_noise_seed(NoiseRepellentAdaptive *self,
+                                    const float *samples,
+                                    uint32_t number_of_samples);
+NREPELLENT_API bool
+nrepellent_adaptive_load_noise_seed_file(NoiseRepellentAdaptive *self,
+                                         const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -18,30 +18,76 @@ along with this program; if not, write to the Free Software Foundation,
 Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 
-#include "../src/signal_crossfade.h"
+#include "../include/nrepellent.h"
+#include "../src/channel_layout.h"
+#include "../src/log_ring.h"
+#include "../src/mid_side.h"
+#include "../src/quality_governor.h"
+#include "../src/run_counters.h"
+#include "../src/run_histogram.h"
+#include "../src/signal_pipeline.h"
+#include "../src/simd_kernels.h"
+#include "../src/thread_pool.h"
+#include "../src/usdt_probes.h"
 #include "lv2/atom/atom.h"
 #include "lv2/core/lv2.h"
 #include "lv2/core/lv2_util.h"
 #include "lv2/log/logger.h"
+#include "lv2/state/state.h"
 #include "lv2/urid/urid.h"
-#include "specbleach_adenoiser.h"
+#include "lv2/worker/worker.h"
+#include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define NOISEREPELLENT_ADAPTIVE_URI                                            \
   "https://github.com/lucianodato/noise-repellent#adaptive"
 #define NOISEREPELLENT_ADAPTIVE_STEREO_URI                                     \
   "https://github.com/lucianodato/noise-repellent#adaptive-stereo"
-#define FRAME_SIZE 36
+#define NOISEREPELLENT_ADAPTIVE_MULTICHANNEL_URI(layout)                       \
+  "https://github.com/lucianodato/noise-repellent#adaptive-" layout
+#define WARM_START_SEED_ENV "NREPELLENT_ADAPTIVE_SEED"
+#define PIPELINE_ENV "NREPELLENT_PIPELINE"
+#define GOVERNOR_ENV "NREPELLENT_GOVERNOR"
+#define HISTOGRAM_ENV "NREPELLENT_HISTOGRAM"
+#define DEFAULT_MAXIMUM_LOAD 50L // Percent of the block duration
+#define MAXIMUM_CHANNELS CHANNEL_LAYOUT_MAXIMUM_CHANNELS
+#define PARALLEL_MINIMUM_SAMPLES 256U
+#define LOG_CAPACITY 64U
 
 typedef struct URIs {
+  LV2_URID atom_Float;
+  LV2_URID atom_Vector;
   LV2_URID plugin;
 } URIs;
 
+typedef struct State {
+  LV2_URID property_noise_seed[MAXIMUM_CHANNELS];
+} State;
+
 static void map_uris(LV2_URID_Map *map, URIs *uris, const char *uri) {
   uris->plugin =
       strcmp(uri, NOISEREPELLENT_ADAPTIVE_URI)
           ? map->map(map->handle, NOISEREPELLENT_ADAPTIVE_URI)
           : map->map(map->handle, NOISEREPELLENT_ADAPTIVE_STEREO_URI);
+  uris->atom_Float = map->map(map->handle, LV2_ATOM__Float);
+  uris->atom_Vector = map->map(map->handle, LV2_ATOM__Vector);
+}
+
+static void map_state(LV2_URID_Map *map, State *state, const char *uri,
+                      const uint32_t number_of_channels) {
+  if (number_of_channels > 1U) {
+    char property[256];
+    for (uint32_t c = 0U; c < number_of_channels; c++) {
+      snprintf(property, sizeof(property), "%s#noiseseed%u", uri,
+               (unsigned int)c + 1U);
+      state->property_noise_seed[c] = map->map(map->handle, property);
+    }
+  } else {
+    state->property_noise_seed[0] =
+        map->map(map->handle, NOISEREPELLENT_ADAPTIVE_URI "#noiseseed");
+  }
 }
 
 typedef enum PortIndex {
@@ -60,23 +106,69 @@ typedef enum PortIndex {
   NOISEREPELLENT_OUTPUT_2 = 12,
 } PortIndex;
 
+// Audio ports come in input and output pairs from NOISEREPELLENT_INPUT_1.
+// After them stereo has the mid_side toggle and layouts with an LFE channel
+// the exclude_lfe one, then come the quality and the optional performance
+// outputs.
+
+struct NoiseRepellentAdaptivePlugin;
+
+typedef struct PluginChannel {
+  struct NoiseRepellentAdaptivePlugin *plugin;
+  uint32_t index;
+  ThreadPoolTask task;
+} PluginChannel;
+
 typedef struct NoiseRepellentAdaptivePlugin {
-  const float *input_1;
-  const float *input_2;
-  float *output_1;
-  float *output_2;
+  const float *inputs[MAXIMUM_CHANNELS];
+  float *outputs[MAXIMUM_CHANNELS];
   float sample_rate;
   float *report_latency;
+  float *exclude_lfe;
+  float *mid_side_mode;
+  float *quality;
+  float *run_counter_ports[RUN_COUNTERS_REPORTS];
 
   LV2_URID_Map *map;
   LV2_Log_Logger log;
+  LV2_Worker_Schedule *schedule;
   URIs uris;
+  State state;
   char *plugin_uri;
 
-  SpectralBleachHandle lib_instance_1;
-  SpectralBleachHandle lib_instance_2;
-  SpectralBleachParameters parameters;
-  SignalCrossfade *soft_bypass;
+  uint32_t number_of_channels;
+  uint32_t lfe_channel;
+  NoiseRepellentAdaptive *denoisers[MAXIMUM_CHANNELS];
+
+  MidSide *mid_side;
+  float mid[MID_SIDE_MAX_BLOCK];
+
+  QualityGovernor *governor;
+  RunCounters *run_counters;
+
+  // Only when NREPELLENT_HISTOGRAM names the file written at cleanup
+  RunHistogram *run_histogram;
+  char *histogram_path;
+
+  // Diagnostics from process_block, printed by the host worker
+  LogRing *log_ring;
+  bool log_drain_scheduled;
+  uint32_t logged_quality;
+  bool logged_non_finite[MAXIMUM_CHANNELS];
+
+  ThreadPool *thread_pool;
+  PluginChannel channels[MAXIMUM_CHANNELS];
+  SignalPipeline *pipeline;
+  ThreadPoolTask pipeline_task;
+  bool pipeline_submitted;
+
+  // What process_block works on, the host buffers or pipeline chunks
+  const float *block_inputs[MAXIMUM_CHANNELS];
+  float *block_outputs[MAXIMUM_CHANNELS];
+  uint32_t number_of_samples;
+  NoiseRepellentParameters parameters;
+  bool mid_side_requested;
+  bool lfe_excluded;
 
   float *enable;
   float *residual_listen;
@@ -89,31 +181,158 @@ typedef struct NoiseRepellentAdaptivePlugin {
 
 } NoiseRepellentAdaptivePlugin;
 
+// Waits for the block the pool may still be processing
+static void finish_pipeline(NoiseRepellentAdaptivePlugin *self) {
+  if (self->pipeline_submitted) {
+    thread_pool_wait(self->thread_pool, &self->pipeline_task);
+    self->pipeline_submitted = false;
+  }
+}
+
+// Prints what process_block queued. Only ever called from one thread at a
+// time: the host worker, or save() and cleanup() when there is none.
+static void drain_log(NoiseRepellentAdaptivePlugin *self) {
+  LogRecord record;
+  while (log_ring_read(self->log_ring, &record)) {
+    switch (record.level) {
+    case LOG_RING_ERROR:
+      lv2_log_error(&self->log, record.format, record.arguments[0],
+                    record.arguments[1]);
+      break;
+    case LOG_RING_WARNING:
+      lv2_log_warning(&self->log, record.format, record.arguments[0],
+                      record.arguments[1]);
+      break;
+    default:
+      lv2_log_note(&self->log, record.format, record.arguments[0],
+                   record.arguments[1]);
+      break;
+    }
+  }
+
+  const uint32_t dropped = log_ring_take_dropped(self->log_ring);
+  if (dropped > 0U) {
+    lv2_log_warning(&self->log, "Dropped <%u> log messages\n",
+                    (unsigned int)dropped);
+  }
+}
+
 static void cleanup(LV2_Handle instance) {
   NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
+  USDT_PROBE1(cleanup, self);
+
+  finish_pipeline(self);
+
+  if (self->pipeline) {
+    signal_pipeline_free(self->pipeline);
+  }
 
-  if (self->lib_instance_1) {
-    specbleach_adaptive_free(self->lib_instance_1);
+  for (uint32_t c = 0U; c < MAXIMUM_CHANNELS; c++) {
+    if (self->denoisers[c]) {
+      nrepellent_adaptive_free(self->denoisers[c]);
+    }
+  }
+
+  if (self->mid_side) {
+    mid_side_free(self->mid_side);
+  }
+
+  if (self->governor) {
+    quality_governor_free(self->governor);
+  }
+
+  if (self->run_counters) {
+    run_counters_free(self->run_counters);
+  }
+
+  if (self->run_histogram) {
+    if (!run_histogram_write(self->run_histogram, self->histogram_path,
+                             self->plugin_uri, (uint32_t)self->sample_rate)) {
+      lv2_log_warning(&self->log, "Could not write the run histogram to %s\n",
+                      self->histogram_path);
+    }
+    run_histogram_free(self->run_histogram);
+  }
+
+  if (self->histogram_path) {
+    free(self->histogram_path);
+  }
+
+  if (self->log_ring) {
+    drain_log(self);
+    log_ring_free(self->log_ring);
   }
 
-  if (self->lib_instance_2) {
-    specbleach_adaptive_free(self->lib_instance_2);
+  if (self->thread_pool) {
+    thread_pool_release(self->thread_pool);
   }
 
   if (self->plugin_uri) {
     free(self->plugin_uri);
   }
 
-  if (self->soft_bypass) {
-    signal_crossfade_free(self->soft_bypass);
+  free(instance);
+}
+
+// An excluded LFE channel goes through the bypass, still delay compensated
+static void process_channel(void *context) {
+  const PluginChannel *channel = (const PluginChannel *)context;
+  const NoiseRepellentAdaptivePlugin *self = channel->plugin;
+
+  NoiseRepellentParameters parameters = self->parameters;
+  if (channel->index == self->lfe_channel && self->lfe_excluded) {
+    parameters.enable = false;
   }
+  quality_governor_apply(quality_governor_get_level(self->governor),
+                         &parameters);
+
+  USDT_PROBE3(channel_start, self, channel->index, self->number_of_samples);
+  nrepellent_adaptive_load_parameters(self->denoisers[channel->index],
+                                      parameters);
+  nrepellent_adaptive_process(
+      self->denoisers[channel->index], self->number_of_samples,
+      self->block_inputs[channel->index], self->block_outputs[channel->index]);
+  USDT_PROBE3(channel_end, self, channel->index, self->number_of_samples);
+}
 
-  free(instance);
+static const LV2_Descriptor *get_descriptor(uint32_t index);
+static void process_pipeline(void *context);
+
+static uint32_t get_number_of_channels(const char *uri,
+                                       uint32_t *lfe_channel) {
+  *lfe_channel = CHANNEL_LAYOUT_NO_LFE;
+
+  if (!strcmp(uri, NOISEREPELLENT_ADAPTIVE_URI)) {
+    return 1U;
+  }
+  if (!strcmp(uri, NOISEREPELLENT_ADAPTIVE_STEREO_URI)) {
+    return 2U;
+  }
+
+  for (uint32_t i = 0U; i < channel_layout_get_count(); i++) {
+    if (!strcmp(uri, get_descriptor(i + 2U)->URI)) {
+      *lfe_channel = channel_layout_get(i)->lfe_channel;
+      return channel_layout_get(i)->number_of_channels;
+    }
+  }
+
+  return 0U;
+}
+
+static bool is_offline(const LV2_Feature *const *features) {
+  for (uint32_t i = 0U; features && features[i]; i++) {
+    if (!strcmp(features[i]->URI, QUALITY_GOVERNOR_OFFLINE_URI)) {
+      return true;
+    }
+  }
+  return false;
 }
 
 static LV2_Handle instantiate(const LV2_Descriptor *descriptor,
                               const double rate, const char *bundle_path,
                               const LV2_Feature *const *features) {
+  USDT_PROBE2(instantiate_start, descriptor->URI, (uint32_t)rate);
+
   NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)calloc(
       1U, sizeof(NoiseRepellentAdaptivePlugin));
 
@@ -122,6 +341,7 @@ static LV2_Handle instantiate(const LV2_Descriptor *descriptor,
       lv2_features_query(features,
                          LV2_LOG__log, &self->log.log, false,
                          LV2_URID__map, &self->map, true,
+                         LV2_WORKER__schedule, &self->schedule, false,
                          NULL);
   // clang-format on
 
@@ -133,48 +353,147 @@ static LV2_Handle instantiate(const LV2_Descriptor *descriptor,
     return NULL;
   }
 
-  if (!strcmp(descriptor->URI, NOISEREPELLENT_ADAPTIVE_STEREO_URI)) {
-    self->plugin_uri = (char *)calloc(
-        strlen(NOISEREPELLENT_ADAPTIVE_STEREO_URI) + 1, sizeof(char));
-    strcpy(self->plugin_uri, descriptor->URI);
-  } else {
-    self->plugin_uri =
-        (char *)calloc(strlen(NOISEREPELLENT_ADAPTIVE_URI) + 1, sizeof(char));
-    strcpy(self->plugin_uri, descriptor->URI);
-  }
+  self->plugin_uri = (char *)calloc(strlen(descriptor->URI) + 1U, sizeof(char));
+  strcpy(self->plugin_uri, descriptor->URI);
+
+  self->number_of_channels =
+      get_number_of_channels(self->plugin_uri, &self->lfe_channel);
 
   map_uris(self->map, &self->uris, self->plugin_uri);
+  map_state(self->map, &self->state, self->plugin_uri,
+            self->number_of_channels);
 
   self->sample_rate = (float)rate;
 
-  self->lib_instance_1 =
-      specbleach_adaptive_initialize((uint32_t)self->sample_rate, FRAME_SIZE);
-  if (!self->lib_instance_1) {
-    cleanup((LV2_Handle)self);
-    return NULL;
+  lv2_log_note(&self->log, "Using <%s> kernels\n", simd_kernels_get()->name);
+
+  for (uint32_t c = 0U; c < self->number_of_channels; c++) {
+    self->denoisers[c] =
+        nrepellent_adaptive_initialize((uint32_t)self->sample_rate);
+    if (!self->denoisers[c]) {
+      lv2_log_error(&self->log, "Error initializing <%s>\n", self->plugin_uri);
+      cleanup((LV2_Handle)self);
+      return NULL;
+    }
+
+    self->channels[c].plugin = self;
+    self->channels[c].index = c;
+    thread_pool_task_initialize(&self->channels[c].task, process_channel,
+                                &self->channels[c]);
   }
 
-  self->soft_bypass = signal_crossfade_initialize((uint32_t)self->sample_rate);
+  if (self->number_of_channels == 2U) {
+    self->mid_side = mid_side_initialize(
+        (uint32_t)self->sample_rate,
+        nrepellent_adaptive_get_latency(self->denoisers[0]));
+    if (!self->mid_side) {
+      lv2_log_error(&self->log, "Error initializing <%s>\n", self->plugin_uri);
+      cleanup((LV2_Handle)self);
+      return NULL;
+    }
+  }
 
-  if (!self->soft_bypass) {
+  // The load over which the quality steps down, 0 keeps it always full as
+  // offline renders do
+  const char *maximum_load = getenv(GOVERNOR_ENV);
+  long percent = maximum_load ? strtol(maximum_load, NULL, 10)
+                              : DEFAULT_MAXIMUM_LOAD;
+  if (is_offline(features)) {
+    percent = 0L;
+  }
+  self->governor = quality_governor_initialize((uint32_t)self->sample_rate,
+                                               (float)percent / 100.F);
+  self->run_counters = run_counters_initialize((uint32_t)self->sample_rate);
+  self->log_ring = log_ring_initialize(LOG_CAPACITY);
+  self->logged_quality = QUALITY_GOVERNOR_FULL;
+  if (!self->governor || !self->run_counters || !self->log_ring) {
+    lv2_log_error(&self->log, "Error initializing <%s>\n", self->plugin_uri);
     cleanup((LV2_Handle)self);
     return NULL;
   }
 
-  if (!strcmp(self->plugin_uri, NOISEREPELLENT_ADAPTIVE_STEREO_URI)) {
-    self->lib_instance_2 =
-        specbleach_adaptive_initialize((uint32_t)self->sample_rate, FRAME_SIZE);
-
-    if (!self->lib_instance_2) {
+  const char *histogram_path = getenv(HISTOGRAM_ENV);
+  if (histogram_path && histogram_path[0] != '\0') {
+    self->histogram_path =
+        (char *)calloc(strlen(histogram_path) + 1U, sizeof(char));
+    self->run_histogram = run_histogram_initialize();
+    if (!self->histogram_path || !self->run_histogram) {
       lv2_log_error(&self->log, "Error initializing <%s>\n", self->plugin_uri);
       cleanup((LV2_Handle)self);
       return NULL;
     }
+    strcpy(self->histogram_path, histogram_path);
+  }
+
+  // Optional pipelining of the whole processing, e.g. NREPELLENT_PIPELINE=64
+  // for hosts running blocks of 64 samples
+  const char *pipeline_latency = getenv(PIPELINE_ENV);
+  const long latency =
+      pipeline_latency ? strtol(pipeline_latency, NULL, 10) : 0L;
+
+  // Shared with the manual binary when the host loaded it too
+  if (self->number_of_channels > 1U || latency > 0L) {
+    const char *const siblings[] = {"nrepellent", NULL};
+    self->thread_pool = thread_pool_acquire(bundle_path, siblings);
   }
 
+  if (latency > 0L && latency <= (long)SIGNAL_PIPELINE_MAX_LATENCY &&
+      self->thread_pool) {
+    self->pipeline =
+        signal_pipeline_initialize(self->number_of_channels, (uint32_t)latency);
+    thread_pool_task_initialize(&self->pipeline_task, process_pipeline, self);
+    lv2_log_note(&self->log, "Pipelined with <%ld> samples of latency\n",
+                 latency);
+  } else if (latency != 0L) {
+    lv2_log_warning(&self->log, "Not pipelining, <%s> needs worker threads "
+                                "and at most %u samples\n",
+                    PIPELINE_ENV, SIGNAL_PIPELINE_MAX_LATENCY);
+  }
+
+  // Optional seed for instances without a saved state, e.g. a recording of
+  // the room tone as raw native floats at the plugin sample rate
+  const char *seed_path = getenv(WARM_START_SEED_ENV);
+  if (seed_path &&
+      nrepellent_adaptive_load_noise_seed_file(self->denoisers[0], seed_path)) {
+    lv2_log_note(&self->log, "Warm starting from seed <%s>\n", seed_path);
+
+    for (uint32_t c = 1U; c < self->number_of_channels; c++) {
+      nrepellent_adaptive_load_noise_seed_file(self->denoisers[c], seed_path);
+    }
+  }
+
+  USDT_PROBE2(instantiate_end, self, self->number_of_channels);
   return (LV2_Handle)self;
 }
 
+static void connect_audio_port(NoiseRepellentAdaptivePlugin *self,
+                               const uint32_t audio_port, void *data) {
+  const uint32_t channel = audio_port / 2U;
+  const bool has_layout_toggle = self->lfe_channel != CHANNEL_LAYOUT_NO_LFE ||
+                                 self->number_of_channels == 2U;
+  const uint32_t quality_port =
+      2U * self->number_of_channels + (has_layout_toggle ? 1U : 0U);
+
+  if (channel < self->number_of_channels) {
+    if (audio_port % 2U == 0U) {
+      self->inputs[channel] = (const float *)data;
+    } else {
+      self->outputs[channel] = (float *)data;
+    }
+  } else if (audio_port == quality_port) {
+    self->quality = (float *)data;
+  } else if (audio_port > quality_port &&
+             audio_port <= quality_port + RUN_COUNTERS_REPORTS) {
+    self->run_counter_ports[audio_port - quality_port - 1U] = (float *)data;
+  } else if (audio_port == 2U * self->number_of_channels) {
+    if (self->lfe_channel != CHANNEL_LAYOUT_NO_LFE) {
+      self->exclude_lfe = (float *)data;
+    } else if (self->number_of_channels == 2U) {
+      self->mid_side_mode = (float *)data;
+    }
+  }
+}
+
 static void connect_port(LV2_Handle instance, uint32_t port, void *data) {
   NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
 
@@ -206,31 +525,8 @@ static void connect_port(LV2_Handle instance, uint32_t port, void *data) {
   case NOISEREPELLENT_LATENCY:
     self->report_latency = (float *)data;
     break;
-  case NOISEREPELLENT_INPUT_1:
-    self->input_1 = (const float *)data;
-    break;
-  case NOISEREPELLENT_OUTPUT_1:
-    self->output_1 = (float *)data;
-    break;
-  default:
-    break;
-  }
-}
-
-static void connect_port_stereo(LV2_Handle instance, uint32_t port,
-                                void *data) {
-  NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
-
-  connect_port(instance, port, data);
-
-  switch ((PortIndex)port) {
-  case NOISEREPELLENT_INPUT_2:
-    self->input_2 = (const float *)data;
-    break;
-  case NOISEREPELLENT_OUTPUT_2:
-    self->output_2 = (float *)data;
-    break;
   default:
+    connect_audio_port(self, port - NOISEREPELLENT_INPUT_1, data);
     break;
   }
 }
@@ -239,14 +535,16 @@ static void activate(LV2_Handle instance) {
   NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
 
   *self->report_latency =
-      (float)specbleach_adaptive_get_latency(self->lib_instance_1);
+      (float)(nrepellent_adaptive_get_latency(self->denoisers[0]) +
+              (self->pipeline ? signal_pipeline_get_latency(self->pipeline)
+                              : 0U));
 }
 
-static void run(LV2_Handle instance, uint32_t number_of_samples) {
-  NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
-
+static NoiseRepellentParameters
+read_parameters(NoiseRepellentAdaptivePlugin *self) {
   // clang-format off
-  self->parameters = (SpectralBleachParameters){
+  return (NoiseRepellentParameters){
+      .enable = (bool)*self->enable,
       .residual_listen = (bool)*self->residual_listen,
       .reduction_amount = *self->reduction_amount,
       .smoothing_factor = *self->smoothing_factor,
@@ -256,63 +554,402 @@ static void run(LV2_Handle instance, uint32_t number_of_samples) {
       .post_filter_threshold = *self->postfilter_threshold,
   };
   // clang-format on
+}
+
+// Only the mid goes through a denoiser, the first one. The side follows
+// its gain, which is where the mode saves the cost of the second channel.
+static void run_mid_side(NoiseRepellentAdaptivePlugin *self) {
+  const uint32_t number_of_samples = self->number_of_samples;
+
+  NoiseRepellentParameters parameters = self->parameters;
+  quality_governor_apply(quality_governor_get_level(self->governor),
+                         &parameters);
+  nrepellent_adaptive_load_parameters(self->denoisers[0], parameters);
+
+  for (uint32_t k = 0U; k < number_of_samples; k += MID_SIDE_MAX_BLOCK) {
+    const uint32_t block = number_of_samples - k < MID_SIDE_MAX_BLOCK
+                               ? number_of_samples - k
+                               : MID_SIDE_MAX_BLOCK;
+
+    mid_side_encode(self->mid_side, block, &self->block_inputs[0][k],
+                    &self->block_inputs[1][k], self->mid);
+    nrepellent_adaptive_process(self->denoisers[0], block, self->mid,
+                                self->mid);
+    mid_side_decode(self->mid_side, block, self->mid,
+                    &self->block_outputs[0][k], &self->block_outputs[1][k]);
+  }
+}
+
+// A single NaN or infinity makes the whole sum non finite
+static bool is_block_finite(const float *block,
+                            const uint32_t number_of_samples) {
+  float sum = 0.F;
+  for (uint32_t k = 0U; k < number_of_samples; k++) {
+    sum += block[k];
+  }
+  return isfinite(sum);
+}
+
+// Queues what changed with the block just processed. Logging only from
+// here keeps a single writer, process_block never runs twice at once.
+static void report_block(NoiseRepellentAdaptivePlugin *self) {
+  const uint32_t quality = quality_governor_get_level(self->governor);
+  if (quality != self->logged_quality) {
+    log_ring_write(self->log_ring, LOG_RING_NOTE, "Quality level <%g>\n",
+                   (double)quality, 0.);
+    self->logged_quality = quality;
+  }
+
+  for (uint32_t c = 0U; c < self->number_of_channels; c++) {
+    const bool non_finite =
+        !is_block_finite(self->block_outputs[c], self->number_of_samples);
+    if (non_finite && !self->logged_non_finite[c]) {
+      log_ring_write(self->log_ring, LOG_RING_WARNING,
+                     "Non finite output on channel <%g>\n",
+                     (double)c + 1., 0.);
+    }
+    self->logged_non_finite[c] = non_finite;
+  }
+}
+
+// Every channel on its own, or the mid only
+static void process_channels(NoiseRepellentAdaptivePlugin *self,
+                             const bool mid_side) {
+  if (mid_side) {
+    run_mid_side(self);
+  } else {
+    // Tiny blocks cost more to hand over than to process
+    const bool parallel = self->number_of_samples >= PARALLEL_MINIMUM_SAMPLES;
+    for (uint32_t c = 1U; parallel && c < self->number_of_channels; c++) {
+      thread_pool_submit(self->thread_pool, &self->channels[c].task);
+    }
+
+    process_channel(&self->channels[0]);
+
+    for (uint32_t c = 1U; c < self->number_of_channels; c++) {
+      if (parallel) {
+        thread_pool_wait(self->thread_pool, &self->channels[c].task);
+      } else {
+        process_channel(&self->channels[c]);
+      }
+    }
+  }
+}
+
+// A mode switch is processed in short steps so the output can fade to dry
+// and change mode in between, see mid_side.h
+static void run_mode_switch(NoiseRepellentAdaptivePlugin *self) {
+  const uint32_t number_of_samples = self->number_of_samples;
+  const float *inputs[2] = {self->block_inputs[0], self->block_inputs[1]};
+  float *outputs[2] = {self->block_outputs[0], self->block_outputs[1]};
+
+  for (uint32_t k = 0U; k < number_of_samples; k += MID_SIDE_MAX_BLOCK) {
+    const uint32_t block = number_of_samples - k < MID_SIDE_MAX_BLOCK
+                               ? number_of_samples - k
+                               : MID_SIDE_MAX_BLOCK;
+
+    const bool mid_side =
+        mid_side_switch(self->mid_side, block, &inputs[0][k], &inputs[1][k],
+                        self->mid_side_requested);
+
+    for (uint32_t c = 0U; c < 2U; c++) {
+      self->block_inputs[c] = &inputs[c][k];
+      self->block_outputs[c] = &outputs[c][k];
+    }
+    self->number_of_samples = block;
+
+    process_channels(self, mid_side);
+    mid_side_fade(self->mid_side, block, &outputs[0][k], &outputs[1][k]);
+  }
+
+  for (uint32_t c = 0U; c < 2U; c++) {
+    self->block_inputs[c] = inputs[c];
+    self->block_outputs[c] = outputs[c];
+  }
+  self->number_of_samples = number_of_samples;
+}
+
+// Processes the block set up in block_inputs, block_outputs and
+// number_of_samples with the controls read by read_block_controls. Its
+// duration is what the quality governor weighs against the block.
+static void process_block(NoiseRepellentAdaptivePlugin *self) {
+  quality_governor_start(self->governor);
+
+  if (!self->mid_side) {
+    process_channels(self, false);
+  } else if (mid_side_is_switching(self->mid_side,
+                                   self->mid_side_requested)) {
+    run_mode_switch(self);
+  } else {
+    mid_side_store_dry(self->mid_side, self->number_of_samples,
+                       self->block_inputs[0], self->block_inputs[1]);
+    process_channels(self, mid_side_is_active(self->mid_side));
+  }
+
+  quality_governor_stop(self->governor, self->number_of_samples);
+  report_block(self);
+}
+
+// Control ports may change while a pipelined block is being processed, so
+// the worker only sees copies of them
+static void read_block_controls(NoiseRepellentAdaptivePlugin *self) {
+  self->parameters = read_parameters(self);
+  self->mid_side_requested = self->mid_side && *self->mid_side_mode > 0.F;
+  self->lfe_excluded =
+      self->lfe_channel != CHANNEL_LAYOUT_NO_LFE && *self->exclude_lfe > 0.F;
+}
+
+static void process_pipeline(void *context) {
+  NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)context;
+
+  while ((self->number_of_samples = signal_pipeline_prepare(
+              self->pipeline, self->block_inputs, self->block_outputs)) > 0U) {
+    process_block(self);
+    signal_pipeline_commit(self->pipeline, self->number_of_samples);
+  }
+}
+
+// The input of a block is processed by the pool while the host is away and
+// its output handed back on the next call. Blocks longer than the pipeline
+// latency can't wait for that and are finished here.
+static void run_pipelined(NoiseRepellentAdaptivePlugin *self,
+                          const uint32_t number_of_samples) {
+  for (uint32_t k = 0U; k < number_of_samples;
+       k += SIGNAL_PIPELINE_MAX_BLOCK) {
+    const uint32_t block = number_of_samples - k < SIGNAL_PIPELINE_MAX_BLOCK
+                               ? number_of_samples - k
+                               : SIGNAL_PIPELINE_MAX_BLOCK;
+
+    finish_pipeline(self);
+    *self->quality = (float)quality_governor_get_level(self->governor);
+
+    const float *inputs[MAXIMUM_CHANNELS];
+    float *outputs[MAXIMUM_CHANNELS];
+    for (uint32_t c = 0U; c < self->number_of_channels; c++) {
+      inputs[c] = &self->inputs[c][k];
+      outputs[c] = &self->outputs[c][k];
+    }
+
+    read_block_controls(self);
+    signal_pipeline_push(self->pipeline, block, inputs);
+
+    if (!signal_pipeline_pull(self->pipeline, block, outputs)) {
+      process_pipeline(self);
+      signal_pipeline_pull(self->pipeline, block, outputs);
+    }
+
+    thread_pool_submit(self->thread_pool, &self->pipeline_task);
+    self->pipeline_submitted = true;
+  }
+}
+
+// Channel frames no denoiser went through: all of them while bypassed,
+// else those of an excluded LFE or of the side in mid/side
+static uint32_t get_skipped_frames(const NoiseRepellentAdaptivePlugin *self,
+                                   const uint32_t number_of_samples) {
+  if (!self->parameters.enable) {
+    return number_of_samples * self->number_of_channels;
+  }
+  return self->mid_side_requested || self->lfe_excluded ? number_of_samples
+                                                     : 0U;
+}
+
+static void write_run_counters(NoiseRepellentAdaptivePlugin *self) {
+  const float *reports = run_counters_get_reports(self->run_counters);
+  for (uint32_t i = 0U; i < RUN_COUNTERS_REPORTS; i++) {
+    if (self->run_counter_ports[i]) {
+      *self->run_counter_ports[i] = reports[i];
+    }
+  }
+}
+
+static void run(LV2_Handle instance, uint32_t number_of_samples) {
+  NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
+  USDT_PROBE2(run_start, self, number_of_samples);
+
+  run_counters_start(self->run_counters);
+  if (self->run_histogram) {
+    run_histogram_start(self->run_histogram);
+  }
 
-  specbleach_adaptive_load_parameters(self->lib_instance_1, self->parameters);
+  if (self->pipeline) {
+    run_pipelined(self, number_of_samples);
+  } else {
+    read_block_controls(self);
+    for (uint32_t c = 0U; c < self->number_of_channels; c++) {
+      self->block_inputs[c] = self->inputs[c];
+      self->block_outputs[c] = self->outputs[c];
+    }
+    self->number_of_samples = number_of_samples;
 
-  if(*self->enable)
-    specbleach_adaptive_process(self->lib_instance_1, number_of_samples,
-                                self->input_1, self->output_1);
+    process_block(self);
+    *self->quality = (float)quality_governor_get_level(self->governor);
+  }
 
-  /*signal_crossfade_run(self->soft_bypass, number_of_samples, self->input_1,
-                       self->output_1, (bool)*self->enable);*/
+  run_counters_stop(self->run_counters, number_of_samples,
+                    get_skipped_frames(self, number_of_samples));
+  write_run_counters(self);
+  if (self->run_histogram) {
+    run_histogram_stop(self->run_histogram, number_of_samples);
+  }
+
+  if (self->schedule && !self->log_drain_scheduled &&
+      log_ring_get_count(self->log_ring) > 0U) {
+    self->log_drain_scheduled =
+        self->schedule->schedule_work(self->schedule->handle, 0U, NULL) ==
+        LV2_WORKER_SUCCESS;
+  }
+  USDT_PROBE2(run_end, self, number_of_samples);
 }
 
-static void run_stereo(LV2_Handle instance, uint32_t number_of_samples) {
+// Seeds are saved as an LV2 Atom Vector body of floats. Hosts copy stored
+// values, so the body only lives for the call.
+static LV2_State_Status store_noise_seed(NoiseRepellentAdaptivePlugin *self,
+                                         NoiseRepellentAdaptive *denoiser,
+                                         LV2_State_Store_Function store,
+                                         LV2_State_Handle handle,
+                                         const LV2_URID property) {
+  uint32_t number_of_samples = 0U;
+  const float *samples =
+      nrepellent_adaptive_get_noise_seed(denoiser, &number_of_samples);
+
+  const size_t size =
+      sizeof(LV2_Atom_Vector_Body) + sizeof(float) * number_of_samples;
+  LV2_Atom_Vector_Body *body = (LV2_Atom_Vector_Body *)malloc(size);
+  if (!body) {
+    return LV2_STATE_ERR_UNKNOWN;
+  }
+
+  body->child_size = (uint32_t)sizeof(float);
+  body->child_type = self->uris.atom_Float;
+  memcpy(body + 1, samples, sizeof(float) * number_of_samples);
+
+  const LV2_State_Status status =
+      store(handle, property, body, size, self->uris.atom_Vector,
+            LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
+  free(body);
+
+  return status;
+}
+
+static bool restore_noise_seed(NoiseRepellentAdaptivePlugin *self,
+                               NoiseRepellentAdaptive *denoiser,
+                               LV2_State_Retrieve_Function retrieve,
+                               LV2_State_Handle handle,
+                               const LV2_URID property) {
+  size_t size = 0U;
+  uint32_t type = 0U;
+  uint32_t valflags = 0U;
+
+  const LV2_Atom_Vector_Body *body = (const LV2_Atom_Vector_Body *)retrieve(
+      handle, property, &size, &type, &valflags);
+  if (!body || type != self->uris.atom_Vector ||
+      size < sizeof(LV2_Atom_Vector_Body) ||
+      body->child_size != sizeof(float)) {
+    return false;
+  }
+
+  return nrepellent_adaptive_load_noise_seed(
+      denoiser, (const float *)(body + 1),
+      (uint32_t)((size - sizeof(LV2_Atom_Vector_Body)) / sizeof(float)));
+}
+
+static LV2_State_Status save(LV2_Handle instance,
+                             LV2_State_Store_Function store,
+                             LV2_State_Handle handle, uint32_t flags,
+                             const LV2_Feature *const *features) {
   NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
+  USDT_PROBE1(save_start, self);
 
-  run(instance, number_of_samples); // Call left side first
+  // Without a worker saving is the next chance to print the log
+  if (!self->schedule) {
+    drain_log(self);
+  }
 
-  specbleach_adaptive_load_parameters(self->lib_instance_2, self->parameters);
+  LV2_State_Status status = LV2_STATE_SUCCESS;
+  for (uint32_t c = 0U;
+       status == LV2_STATE_SUCCESS && c < self->number_of_channels; c++) {
+    status = store_noise_seed(self, self->denoisers[c], store, handle,
+                              self->state.property_noise_seed[c]);
+  }
 
-  if(*self->enable)
-    specbleach_adaptive_process(self->lib_instance_2, number_of_samples,
-                                self->input_2, self->output_2);
+  USDT_PROBE2(save_end, self, status);
+  return status;
+}
 
-  /*signal_crossfade_run(self->soft_bypass, number_of_samples, self->input_2,
-                       self->output_2, (bool)*self->enable);*/
+static LV2_State_Status restore(LV2_Handle instance,
+                                LV2_State_Retrieve_Function retrieve,
+                                LV2_State_Handle handle, uint32_t flags,
+                                const LV2_Feature *const *features) {
+  NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
+  USDT_PROBE1(restore_start, self);
+
+  // Never concurrent with run(), but a pipelined block may be in flight
+  finish_pipeline(self);
+
+  LV2_State_Status status = LV2_STATE_SUCCESS;
+  for (uint32_t c = 0U;
+       status == LV2_STATE_SUCCESS && c < self->number_of_channels; c++) {
+    if (!restore_noise_seed(self, self->denoisers[c], retrieve, handle,
+                            self->state.property_noise_seed[c])) {
+      status = LV2_STATE_ERR_NO_PROPERTY;
+    }
+  }
+
+  USDT_PROBE2(restore_end, self, status);
+  return status;
 }
 
-// clang-format off
-static const LV2_Descriptor descriptor_adaptive = {
-    NOISEREPELLENT_ADAPTIVE_URI,
-    instantiate,
-    connect_port,
-    activate,
-    run,
-    NULL,
-    cleanup,
-    NULL
-};
+static LV2_Worker_Status work(LV2_Handle instance,
+                              LV2_Worker_Respond_Function respond,
+                              LV2_Worker_Respond_Handle handle, uint32_t size,
+                              const void *data) {
+  NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
+
+  drain_log(self);
+
+  return respond(handle, 0U, NULL);
+}
+
+static LV2_Worker_Status work_response(LV2_Handle instance, uint32_t size,
+                                       const void *data) {
+  NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
 
-static const LV2_Descriptor descriptor_adaptive_stereo = {
-    NOISEREPELLENT_ADAPTIVE_STEREO_URI,
-    instantiate,
-    connect_port_stereo,
-    activate,
-    run_stereo,
-    NULL,
-    cleanup,
-    NULL
+  self->log_drain_scheduled = false;
+
+  return LV2_WORKER_SUCCESS;
+}
+
+static const void *extension_data(const char *uri) {
+  static const LV2_State_Interface state = {save, restore};
+  static const LV2_Worker_Interface worker = {work, work_response, NULL};
+  if (strcmp(uri, LV2_STATE__interface) == 0) {
+    return &state;
+  }
+  if (strcmp(uri, LV2_WORKER__interface) == 0) {
+    return &worker;
+  }
+  return NULL;
+}
+
+// clang-format off
+static const LV2_Descriptor descriptors[] = {
+    {NOISEREPELLENT_ADAPTIVE_URI, instantiate, connect_port, activate, run, NULL, cleanup, extension_data},
+    {NOISEREPELLENT_ADAPTIVE_STEREO_URI, instantiate, connect_port, activate, run, NULL, cleanup, extension_data},
+    {NOISEREPELLENT_ADAPTIVE_MULTICHANNEL_URI("quad"), instantiate, connect_port, activate, run, NULL, cleanup, extension_data},
+    {NOISEREPELLENT_ADAPTIVE_MULTICHANNEL_URI("surround51"), instantiate, connect_port, activate, run, NULL, cleanup, extension_data},
+    {NOISEREPELLENT_ADAPTIVE_MULTICHANNEL_URI("surround71"), instantiate, connect_port, activate, run, NULL, cleanup, extension_data},
+    {NOISEREPELLENT_ADAPTIVE_MULTICHANNEL_URI("foa"), instantiate, connect_port, activate, run, NULL, cleanup, extension_data},
 };
 // clang-format on
 
-LV2_SYMBOL_EXPORT const LV2_Descriptor *lv2_descriptor(uint32_t index) {
-  switch (index) {
-  case 0:
-    return &descriptor_adaptive;
-  case 1:
-    return &descriptor_adaptive_stereo;
-  default:
+static const LV2_Descriptor *get_descriptor(uint32_t index) {
+  if (index >= sizeof(descriptors) / sizeof(descriptors[0])) {
     return NULL;
   }
+  return &descriptors[index];
+}
+
+LV2_SYMBOL_EXPORT const LV2_Descriptor *lv2_descriptor(uint32_t index) {
+  return get_descriptor(index);
 }
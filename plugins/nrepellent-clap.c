@@ -0,0 +1,884 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "../include/nrepellent.h"
+#include <clap/clap.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NOISEREPELLENT_CLAP_ID "com.github.lucianodato.noise-repellent"
+#define NOISEREPELLENT_CLAP_STEREO_ID NOISEREPELLENT_CLAP_ID "-stereo"
+#define NOISEREPELLENT_ADAPTIVE_CLAP_ID NOISEREPELLENT_CLAP_ID "-adaptive"
+#define NOISEREPELLENT_ADAPTIVE_CLAP_STEREO_ID                                 \
+  NOISEREPELLENT_ADAPTIVE_CLAP_ID "-stereo"
+
+#define MAXIMUM_CHANNELS 2U
+#define PARALLEL_MINIMUM_SAMPLES 256U
+#define STATE_MAGIC 0x4C43524EU // "NRCL"
+#define STATE_VERSION 1U
+
+typedef struct ClapParameter {
+  const char *name;
+  double minimum;
+  double maximum;
+  double default_value;
+  clap_param_info_flags flags;
+} ClapParameter;
+
+#define STEPPED (CLAP_PARAM_IS_AUTOMATABLE | CLAP_PARAM_IS_STEPPED)
+
+// Ids are the LV2 port indexes of the controls before the latency port.
+// Track noise drift comes after the audio ports in LV2 and takes the next id.
+// clang-format off
+static const ClapParameter manual_parameters[] = {
+    {"Learn noise profile", 0., 3., 0., STEPPED},
+    {"Reduction amount", 0., 40., 10., CLAP_PARAM_IS_AUTOMATABLE},
+    {"Type of reduction", 0., 2., 2., STEPPED},
+    {"Reduction strength", 0., 12., 2., CLAP_PARAM_IS_AUTOMATABLE},
+    {"Post-filter threshold", -10., 10., -10., CLAP_PARAM_IS_AUTOMATABLE},
+    {"Smoothing", 0., 100., 0., CLAP_PARAM_IS_AUTOMATABLE},
+    {"Residual whitening", 0., 100., 0., CLAP_PARAM_IS_AUTOMATABLE},
+    {"Protect Transients", 0., 1., 0., STEPPED},
+    {"Residual listen", 0., 1., 0., STEPPED},
+    {"Reset noise profile", 0., 1., 0., STEPPED},
+    {"Enable", 0., 1., 1., STEPPED},
+    {"Track noise drift", 0., 1., 0., STEPPED},
+};
+
+static const ClapParameter adaptive_parameters[] = {
+    {"Reduction amount", 0., 20., 10., CLAP_PARAM_IS_AUTOMATABLE},
+    {"Type of reduction", 0., 2., 2., STEPPED},
+    {"Reduction strength", 0., 12., 2., CLAP_PARAM_IS_AUTOMATABLE},
+    {"Post-filter threshold", -10., 10., -10., CLAP_PARAM_IS_AUTOMATABLE},
+    {"Smoothing", 0., 100., 0., CLAP_PARAM_IS_AUTOMATABLE},
+    {"Residual whitening", 0., 100., 0., CLAP_PARAM_IS_AUTOMATABLE},
+    {"Residual listen", 0., 1., 0., STEPPED},
+    {"Enable", 0., 1., 1., STEPPED},
+};
+// clang-format on
+
+#define MANUAL_PARAMETERS                                                      \
+  (uint32_t)(sizeof(manual_parameters) / sizeof(manual_parameters[0]))
+#define ADAPTIVE_PARAMETERS                                                    \
+  (uint32_t)(sizeof(adaptive_parameters) / sizeof(adaptive_parameters[0]))
+#define MAXIMUM_PARAMETERS MANUAL_PARAMETERS
+
+typedef struct ClapKind {
+  clap_plugin_descriptor_t descriptor;
+  bool adaptive;
+  uint32_t channels;
+} ClapKind;
+
+static const char *const mono_features[] = {CLAP_PLUGIN_FEATURE_AUDIO_EFFECT,
+                                            CLAP_PLUGIN_FEATURE_RESTORATION,
+                                            CLAP_PLUGIN_FEATURE_MONO, NULL};
+static const char *const stereo_features[] = {
+    CLAP_PLUGIN_FEATURE_AUDIO_EFFECT, CLAP_PLUGIN_FEATURE_RESTORATION,
+    CLAP_PLUGIN_FEATURE_STEREO, NULL};
+
+#define DESCRIPTOR(id, name, description, features)                            \
+  {                                                                            \
+    CLAP_VERSION_INIT, id, name, "Luciano Dato",                               \
+        "https://github.com/lucianodato/noise-repellent", "", "",              \
+        NREPELLENT_VERSION, description, features                              \
+  }
+
+// clang-format off
+static const ClapKind kinds[] = {
+    {DESCRIPTOR(NOISEREPELLENT_CLAP_ID, "Noise repellent",
+                "Broadband noise reduction from a learned profile",
+                mono_features), false, 1U},
+    {DESCRIPTOR(NOISEREPELLENT_CLAP_STEREO_ID, "Noise repellent Stereo",
+                "Broadband noise reduction from a learned profile",
+                stereo_features), false, 2U},
+    {DESCRIPTOR(NOISEREPELLENT_ADAPTIVE_CLAP_ID, "Noise repellent Adaptive",
+                "Adaptive noise reduction for voice",
+                mono_features), true, 1U},
+    {DESCRIPTOR(NOISEREPELLENT_ADAPTIVE_CLAP_STEREO_ID,
+                "Noise repellent Adaptive Stereo",
+                "Adaptive noise reduction for voice",
+                stereo_features), true, 2U},
+};
+// clang-format on
+
+#define NUMBER_OF_KINDS (uint32_t)(sizeof(kinds) / sizeof(kinds[0]))
+
+// Profiles of the manual denoiser or seeds of the adaptive one, read on the
+// main thread and handed to the audio thread to be loaded. Replaying a seed
+// takes too long for a block, so while active the adaptive denoisers are
+// warmed up beforehand and the audio thread only swaps them in.
+typedef struct ClapChannelState {
+  float *elements;
+  uint32_t number_of_elements;
+  uint32_t averaged_blocks;
+  float noise_floor;
+} ClapChannelState;
+
+typedef struct ClapState {
+  ClapChannelState channels[MAXIMUM_CHANNELS];
+  NoiseRepellentAdaptive *adaptive_denoisers[MAXIMUM_CHANNELS];
+  uint32_t sample_rate; // Of the warmed up denoisers
+  double values[MAXIMUM_PARAMETERS];
+} ClapState;
+
+typedef struct NoiseRepellentClap {
+  clap_plugin_t plugin;
+  const clap_host_t *host;
+  const clap_host_thread_pool_t *host_thread_pool;
+  const clap_host_state_t *host_state;
+  const clap_host_params_t *host_params;
+  const ClapKind *kind;
+
+  const ClapParameter *parameters;
+  uint32_t number_of_parameters;
+  double values[MAXIMUM_PARAMETERS];
+
+  NoiseRepellent *denoisers[MAXIMUM_CHANNELS];
+  NoiseRepellentAdaptive *adaptive_denoisers[MAXIMUM_CHANNELS];
+  uint32_t sample_rate;
+  bool active;
+
+  // Hand over of loaded state, owned by whoever swapped it out last
+  ClapState *pending_state;
+  ClapState *applied_state;
+  int state_changed;
+  int values_changed;
+  double previous_learn;
+
+  // Block handed to the host pool, one task per channel
+  NoiseRepellentParameters block_parameters;
+  const clap_audio_buffer_t *block_input;
+  const clap_audio_buffer_t *block_output;
+  uint32_t block_size;
+} NoiseRepellentClap;
+
+static NoiseRepellentClap *get_self(const clap_plugin_t *plugin) {
+  return (NoiseRepellentClap *)plugin->plugin_data;
+}
+
+static void clap_state_free(ClapState *self) {
+  if (!self) {
+    return;
+  }
+
+  for (uint32_t c = 0U; c < MAXIMUM_CHANNELS; c++) {
+    free(self->channels[c].elements);
+    if (self->adaptive_denoisers[c]) {
+      nrepellent_adaptive_free(self->adaptive_denoisers[c]);
+    }
+  }
+  free(self);
+}
+
+// Not realtime safe, runs the seed replay on the main thread
+static bool warm_up_state(ClapState *self, const ClapKind *kind,
+                          const uint32_t sample_rate) {
+  for (uint32_t c = 0U; c < kind->channels; c++) {
+    self->adaptive_denoisers[c] = nrepellent_adaptive_initialize(sample_rate);
+    if (!self->adaptive_denoisers[c]) {
+      return false;
+    }
+
+    if (self->channels[c].elements) {
+      nrepellent_adaptive_load_noise_seed(self->adaptive_denoisers[c],
+                                          self->channels[c].elements,
+                                          self->channels[c].number_of_elements);
+    }
+  }
+
+  self->sample_rate = sample_rate;
+  return true;
+}
+
+static NoiseRepellentParameters read_parameters(const NoiseRepellentClap *self) {
+  const double *values = self->values;
+
+  // clang-format off
+  if (self->kind->adaptive) {
+    return (NoiseRepellentParameters){
+        .enable = values[7] >= 0.5,
+        .residual_listen = values[6] >= 0.5,
+        .reduction_amount = (float)values[0],
+        .smoothing_factor = (float)values[4],
+        .whitening_factor = (float)values[5],
+        .noise_rescale = (float)values[2],
+        .noise_scaling_type = (int)lrint(values[1]),
+        .post_filter_threshold = (float)values[3],
+    };
+  }
+
+  return (NoiseRepellentParameters){
+      .enable = values[10] >= 0.5,
+      .learn_noise = (int)lrint(values[0]),
+      .reset_noise_profile = values[9] >= 0.5,
+      .noise_tracking = values[11] >= 0.5,
+      .residual_listen = values[8] >= 0.5,
+      .transient_protection = values[7] >= 0.5,
+      .noise_scaling_type = (int)lrint(values[2]),
+      .reduction_amount = (float)values[1],
+      .noise_rescale = (float)values[3],
+      .smoothing_factor = (float)values[5],
+      .whitening_factor = (float)values[6],
+      .post_filter_threshold = (float)values[4],
+  };
+  // clang-format on
+}
+
+// Warmed up denoisers are swapped with the current ones, which leave with
+// the state to be freed on the main thread
+static void apply_state(NoiseRepellentClap *self, ClapState *state) {
+  memcpy(self->values, state->values,
+         self->number_of_parameters * sizeof(double));
+  self->previous_learn = self->values[0];
+
+  const bool warmed_up = self->kind->adaptive && state->adaptive_denoisers[0] &&
+                         state->sample_rate == self->sample_rate;
+
+  for (uint32_t c = 0U; c < self->kind->channels; c++) {
+    const ClapChannelState *channel = &state->channels[c];
+    if (warmed_up) {
+      NoiseRepellentAdaptive *previous = self->adaptive_denoisers[c];
+      self->adaptive_denoisers[c] = state->adaptive_denoisers[c];
+      state->adaptive_denoisers[c] = previous;
+      continue;
+    }
+    if (!channel->elements) {
+      continue;
+    }
+
+    if (self->kind->adaptive) {
+      nrepellent_adaptive_load_noise_seed(self->adaptive_denoisers[c],
+                                          channel->elements,
+                                          channel->number_of_elements);
+    } else {
+      nrepellent_load_noise_profile(
+          self->denoisers[c], channel->elements, channel->number_of_elements,
+          channel->averaged_blocks, channel->noise_floor);
+    }
+  }
+}
+
+static void free_denoisers(NoiseRepellentClap *self) {
+  for (uint32_t c = 0U; c < MAXIMUM_CHANNELS; c++) {
+    if (self->denoisers[c]) {
+      nrepellent_free(self->denoisers[c]);
+      self->denoisers[c] = NULL;
+    }
+    if (self->adaptive_denoisers[c]) {
+      nrepellent_adaptive_free(self->adaptive_denoisers[c]);
+      self->adaptive_denoisers[c] = NULL;
+    }
+  }
+}
+
+static bool initialize_denoisers(NoiseRepellentClap *self,
+                                 const uint32_t sample_rate) {
+  free_denoisers(self);
+
+  for (uint32_t c = 0U; c < self->kind->channels; c++) {
+    if (self->kind->adaptive) {
+      self->adaptive_denoisers[c] = nrepellent_adaptive_initialize(sample_rate);
+      if (!self->adaptive_denoisers[c]) {
+        return false;
+      }
+    } else {
+      self->denoisers[c] = nrepellent_initialize(sample_rate);
+      if (!self->denoisers[c]) {
+        return false;
+      }
+    }
+  }
+
+  self->sample_rate = sample_rate;
+  return true;
+}
+
+static bool plugin_init(const clap_plugin_t *plugin) {
+  NoiseRepellentClap *self = get_self(plugin);
+
+  if (self->host->get_extension) {
+    self->host_thread_pool = (const clap_host_thread_pool_t *)
+        self->host->get_extension(self->host, CLAP_EXT_THREAD_POOL);
+    self->host_state = (const clap_host_state_t *)self->host->get_extension(
+        self->host, CLAP_EXT_STATE);
+    self->host_params = (const clap_host_params_t *)self->host->get_extension(
+        self->host, CLAP_EXT_PARAMS);
+  }
+
+  return true;
+}
+
+static void plugin_destroy(const clap_plugin_t *plugin) {
+  NoiseRepellentClap *self = get_self(plugin);
+
+  free_denoisers(self);
+  clap_state_free(self->pending_state);
+  clap_state_free(self->applied_state);
+  free(self);
+}
+
+// Denoisers are kept across activations at the same rate, so a learned
+// profile survives the host changing its block size
+static bool plugin_activate(const clap_plugin_t *plugin,
+                            const double sample_rate,
+                            const uint32_t min_frames_count,
+                            const uint32_t max_frames_count) {
+  NoiseRepellentClap *self = get_self(plugin);
+  const uint32_t rate = (uint32_t)sample_rate;
+
+  const bool ready = self->kind->adaptive ? self->adaptive_denoisers[0] != NULL
+                                          : self->denoisers[0] != NULL;
+  if ((!ready || rate != self->sample_rate) &&
+      !initialize_denoisers(self, rate)) {
+    free_denoisers(self);
+    return false;
+  }
+
+  // State loaded before the first activation
+  ClapState *pending =
+      __atomic_exchange_n(&self->pending_state, NULL, __ATOMIC_ACQ_REL);
+  if (pending) {
+    apply_state(self, pending);
+    clap_state_free(pending);
+  }
+
+  self->active = true;
+  return true;
+}
+
+static void plugin_deactivate(const clap_plugin_t *plugin) {
+  get_self(plugin)->active = false;
+}
+
+static bool plugin_start_processing(const clap_plugin_t *plugin) {
+  return true;
+}
+
+static void plugin_stop_processing(const clap_plugin_t *plugin) {}
+
+// The estimators settle on their own, clearing them would need allocations
+static void plugin_reset(const clap_plugin_t *plugin) {}
+
+static void process_channel(NoiseRepellentClap *self, const uint32_t channel) {
+  const float *input = self->block_input->data32[channel];
+  float *output = self->block_output->data32[channel];
+
+  if (self->kind->adaptive) {
+    nrepellent_adaptive_load_parameters(self->adaptive_denoisers[channel],
+                                        self->block_parameters);
+    nrepellent_adaptive_process(self->adaptive_denoisers[channel],
+                                self->block_size, input, output);
+  } else {
+    nrepellent_load_parameters(self->denoisers[channel],
+                               self->block_parameters);
+    nrepellent_process(self->denoisers[channel], self->block_size, input,
+                       output);
+  }
+}
+
+static void set_parameter(NoiseRepellentClap *self,
+                          const clap_event_header_t *header) {
+  if (header->space_id != CLAP_CORE_EVENT_SPACE_ID ||
+      header->type != CLAP_EVENT_PARAM_VALUE) {
+    return;
+  }
+
+  const clap_event_param_value_t *event =
+      (const clap_event_param_value_t *)header;
+  if (event->param_id >= self->number_of_parameters) {
+    return;
+  }
+
+  const ClapParameter *parameter = &self->parameters[event->param_id];
+  self->values[event->param_id] =
+      fmin(fmax(event->value, parameter->minimum), parameter->maximum);
+}
+
+static void read_events(NoiseRepellentClap *self,
+                        const clap_input_events_t *events) {
+  if (!events) {
+    return;
+  }
+
+  const uint32_t number_of_events = events->size(events);
+  for (uint32_t i = 0U; i < number_of_events; i++) {
+    set_parameter(self, events->get(events, i));
+  }
+}
+
+// Loaded state is taken only once the previous one went back to the main
+// thread, so the audio thread never frees
+static void take_pending_state(NoiseRepellentClap *self) {
+  if (__atomic_load_n(&self->applied_state, __ATOMIC_ACQUIRE)) {
+    return;
+  }
+
+  ClapState *pending =
+      __atomic_exchange_n(&self->pending_state, NULL, __ATOMIC_ACQ_REL);
+  if (!pending) {
+    return;
+  }
+
+  apply_state(self, pending);
+  __atomic_store_n(&self->applied_state, pending, __ATOMIC_RELEASE);
+  __atomic_store_n(&self->values_changed, 1, __ATOMIC_RELEASE);
+  self->host->request_callback(self->host);
+}
+
+static clap_process_status plugin_process(const clap_plugin_t *plugin,
+                                          const clap_process_t *process) {
+  NoiseRepellentClap *self = get_self(plugin);
+  const uint32_t channels = self->kind->channels;
+
+  if (process->audio_inputs_count < 1U || process->audio_outputs_count < 1U ||
+      process->audio_inputs[0].channel_count < channels ||
+      process->audio_outputs[0].channel_count < channels) {
+    return CLAP_PROCESS_ERROR;
+  }
+
+  take_pending_state(self);
+  read_events(self, process->in_events);
+
+  self->block_parameters = read_parameters(self);
+  self->block_input = &process->audio_inputs[0];
+  self->block_output = &process->audio_outputs[0];
+  self->block_size = process->frames_count;
+
+  // One host task per channel, the host runs them inline when it can't
+  const bool parallel = channels > 1U && self->host_thread_pool &&
+                        process->frames_count >= PARALLEL_MINIMUM_SAMPLES &&
+                        self->host_thread_pool->request_exec(self->host,
+                                                             channels);
+  if (!parallel) {
+    for (uint32_t c = 0U; c < channels; c++) {
+      process_channel(self, c);
+    }
+  }
+
+  // A finished capture changes what save() would store
+  if (!self->kind->adaptive) {
+    if (self->previous_learn != 0. && self->values[0] == 0.) {
+      __atomic_store_n(&self->state_changed, 1, __ATOMIC_RELEASE);
+      self->host->request_callback(self->host);
+    }
+    self->previous_learn = self->values[0];
+  }
+
+  return CLAP_PROCESS_CONTINUE;
+}
+
+static void plugin_on_main_thread(const clap_plugin_t *plugin) {
+  NoiseRepellentClap *self = get_self(plugin);
+
+  clap_state_free(
+      __atomic_exchange_n(&self->applied_state, NULL, __ATOMIC_ACQ_REL));
+
+  if (__atomic_exchange_n(&self->state_changed, 0, __ATOMIC_ACQ_REL) &&
+      self->host_state) {
+    self->host_state->mark_dirty(self->host);
+  }
+
+  if (__atomic_exchange_n(&self->values_changed, 0, __ATOMIC_ACQ_REL) &&
+      self->host_params) {
+    self->host_params->rescan(self->host, CLAP_PARAM_RESCAN_VALUES);
+  }
+}
+
+static void thread_pool_exec(const clap_plugin_t *plugin,
+                             const uint32_t task_index) {
+  process_channel(get_self(plugin), task_index);
+}
+
+static uint32_t audio_ports_count(const clap_plugin_t *plugin,
+                                  const bool is_input) {
+  return 1U;
+}
+
+static bool audio_ports_get(const clap_plugin_t *plugin, const uint32_t index,
+                            const bool is_input, clap_audio_port_info_t *info) {
+  const NoiseRepellentClap *self = get_self(plugin);
+  if (index != 0U) {
+    return false;
+  }
+
+  info->id = 0U;
+  snprintf(info->name, sizeof(info->name), "%s", is_input ? "Input" : "Output");
+  info->flags = CLAP_AUDIO_PORT_IS_MAIN;
+  info->channel_count = self->kind->channels;
+  info->port_type =
+      self->kind->channels == 2U ? CLAP_PORT_STEREO : CLAP_PORT_MONO;
+  info->in_place_pair = CLAP_INVALID_ID;
+
+  return true;
+}
+
+static uint32_t params_count(const clap_plugin_t *plugin) {
+  return get_self(plugin)->number_of_parameters;
+}
+
+static bool params_get_info(const clap_plugin_t *plugin, const uint32_t index,
+                            clap_param_info_t *info) {
+  const NoiseRepellentClap *self = get_self(plugin);
+  if (index >= self->number_of_parameters) {
+    return false;
+  }
+
+  const ClapParameter *parameter = &self->parameters[index];
+  memset(info, 0, sizeof(clap_param_info_t));
+  info->id = index;
+  info->flags = parameter->flags;
+  snprintf(info->name, sizeof(info->name), "%s", parameter->name);
+  info->min_value = parameter->minimum;
+  info->max_value = parameter->maximum;
+  info->default_value = parameter->default_value;
+
+  return true;
+}
+
+static bool params_get_value(const clap_plugin_t *plugin, const clap_id id,
+                             double *value) {
+  const NoiseRepellentClap *self = get_self(plugin);
+  if (id >= self->number_of_parameters) {
+    return false;
+  }
+
+  *value = self->values[id];
+  return true;
+}
+
+static bool params_value_to_text(const clap_plugin_t *plugin, const clap_id id,
+                                 const double value, char *buffer,
+                                 const uint32_t capacity) {
+  const NoiseRepellentClap *self = get_self(plugin);
+  if (id >= self->number_of_parameters) {
+    return false;
+  }
+
+  const bool stepped = self->parameters[id].flags & CLAP_PARAM_IS_STEPPED;
+  snprintf(buffer, capacity, stepped ? "%.0f" : "%.2f", value);
+  return true;
+}
+
+static bool params_text_to_value(const clap_plugin_t *plugin, const clap_id id,
+                                 const char *text, double *value) {
+  const NoiseRepellentClap *self = get_self(plugin);
+  if (id >= self->number_of_parameters) {
+    return false;
+  }
+
+  char *end = NULL;
+  *value = strtod(text, &end);
+  return end != text;
+}
+
+static void params_flush(const clap_plugin_t *plugin,
+                         const clap_input_events_t *in,
+                         const clap_output_events_t *out) {
+  read_events(get_self(plugin), in);
+}
+
+static uint32_t latency_get(const clap_plugin_t *plugin) {
+  const NoiseRepellentClap *self = get_self(plugin);
+
+  if (self->kind->adaptive) {
+    return self->adaptive_denoisers[0]
+               ? nrepellent_adaptive_get_latency(self->adaptive_denoisers[0])
+               : 0U;
+  }
+  return self->denoisers[0] ? nrepellent_get_latency(self->denoisers[0]) : 0U;
+}
+
+// What is still buffered comes out once the input stops
+static uint32_t tail_get(const clap_plugin_t *plugin) {
+  return latency_get(plugin);
+}
+
+static bool write_all(const clap_ostream_t *stream, const void *buffer,
+                      uint64_t size) {
+  const char *cursor = (const char *)buffer;
+  while (size > 0U) {
+    const int64_t written = stream->write(stream, cursor, size);
+    if (written <= 0) {
+      return false;
+    }
+    cursor += written;
+    size -= (uint64_t)written;
+  }
+  return true;
+}
+
+static bool read_all(const clap_istream_t *stream, void *buffer,
+                     uint64_t size) {
+  char *cursor = (char *)buffer;
+  while (size > 0U) {
+    const int64_t read = stream->read(stream, cursor, size);
+    if (read <= 0) {
+      return false;
+    }
+    cursor += read;
+    size -= (uint64_t)read;
+  }
+  return true;
+}
+
+static bool save_channel(NoiseRepellentClap *self, const uint32_t channel,
+                         const clap_ostream_t *stream) {
+  ClapChannelState state = {NULL, 0U, 0U, 0.F};
+  const float *elements = NULL;
+
+  if (self->kind->adaptive) {
+    if (self->adaptive_denoisers[channel]) {
+      elements = nrepellent_adaptive_get_noise_seed(
+          self->adaptive_denoisers[channel], &state.number_of_elements);
+    }
+  } else if (self->denoisers[channel] &&
+             nrepellent_noise_profile_available(self->denoisers[channel])) {
+    state.number_of_elements =
+        nrepellent_get_noise_profile_size(self->denoisers[channel]);
+    state.elements = (float *)calloc(state.number_of_elements, sizeof(float));
+    if (!state.elements) {
+      return false;
+    }
+    nrepellent_get_noise_profile(self->denoisers[channel], state.elements,
+                                 &state.averaged_blocks, &state.noise_floor);
+    elements = state.elements;
+  }
+
+  if (!elements) {
+    state.number_of_elements = 0U;
+  }
+
+  const bool saved =
+      write_all(stream, &state.number_of_elements, sizeof(uint32_t)) &&
+      write_all(stream, &state.averaged_blocks, sizeof(uint32_t)) &&
+      write_all(stream, &state.noise_floor, sizeof(float)) &&
+      write_all(stream, elements,
+                (uint64_t)state.number_of_elements * sizeof(float));
+
+  free(state.elements);
+  return saved;
+}
+
+// Native endian, like the LV2 state: magic, version, the parameter values
+// and then per channel the profile or seed, empty when there is none
+static bool state_save(const clap_plugin_t *plugin,
+                       const clap_ostream_t *stream) {
+  NoiseRepellentClap *self = get_self(plugin);
+
+  const uint32_t header[] = {STATE_MAGIC, STATE_VERSION,
+                             self->number_of_parameters,
+                             self->kind->channels};
+  if (!write_all(stream, header, sizeof(header)) ||
+      !write_all(stream, self->values,
+                 self->number_of_parameters * sizeof(double))) {
+    return false;
+  }
+
+  for (uint32_t c = 0U; c < self->kind->channels; c++) {
+    if (!save_channel(self, c, stream)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool load_channel(ClapChannelState *channel,
+                         const clap_istream_t *stream) {
+  if (!read_all(stream, &channel->number_of_elements, sizeof(uint32_t)) ||
+      !read_all(stream, &channel->averaged_blocks, sizeof(uint32_t)) ||
+      !read_all(stream, &channel->noise_floor, sizeof(float))) {
+    return false;
+  }
+
+  if (channel->number_of_elements == 0U) {
+    return true;
+  }
+
+  channel->elements =
+      (float *)calloc(channel->number_of_elements, sizeof(float));
+  return channel->elements &&
+         read_all(stream, channel->elements,
+                  (uint64_t)channel->number_of_elements * sizeof(float));
+}
+
+static bool state_load(const clap_plugin_t *plugin,
+                       const clap_istream_t *stream) {
+  NoiseRepellentClap *self = get_self(plugin);
+
+  uint32_t header[4];
+  if (!read_all(stream, header, sizeof(header)) || header[0] != STATE_MAGIC ||
+      header[1] != STATE_VERSION ||
+      header[2] != self->number_of_parameters ||
+      header[3] != self->kind->channels) {
+    return false;
+  }
+
+  ClapState *state = (ClapState *)calloc(1U, sizeof(ClapState));
+  if (!state) {
+    return false;
+  }
+
+  if (!read_all(stream, state->values,
+                self->number_of_parameters * sizeof(double))) {
+    clap_state_free(state);
+    return false;
+  }
+
+  for (uint32_t c = 0U; c < self->kind->channels; c++) {
+    if (!load_channel(&state->channels[c], stream)) {
+      clap_state_free(state);
+      return false;
+    }
+  }
+
+  if (self->active && self->kind->adaptive &&
+      !warm_up_state(state, self->kind, self->sample_rate)) {
+    clap_state_free(state);
+    return false;
+  }
+
+  // Loaded right away while the audio thread is stopped, otherwise at the
+  // start of its next block, which also takes the parameter values then
+  if (!self->active) {
+    memcpy(self->values, state->values,
+           self->number_of_parameters * sizeof(double));
+    self->previous_learn = self->values[0];
+  }
+  clap_state_free(
+      __atomic_exchange_n(&self->applied_state, NULL, __ATOMIC_ACQ_REL));
+  if (!self->active && self->sample_rate > 0U) {
+    apply_state(self, state);
+    clap_state_free(state);
+    state = NULL;
+  }
+  clap_state_free(
+      __atomic_exchange_n(&self->pending_state, state, __ATOMIC_ACQ_REL));
+
+  return true;
+}
+
+static const clap_plugin_audio_ports_t audio_ports = {audio_ports_count,
+                                                      audio_ports_get};
+static const clap_plugin_params_t params = {
+    params_count,         params_get_info,      params_get_value,
+    params_value_to_text, params_text_to_value, params_flush};
+static const clap_plugin_latency_t latency = {latency_get};
+static const clap_plugin_tail_t tail = {tail_get};
+static const clap_plugin_state_t state = {state_save, state_load};
+static const clap_plugin_thread_pool_t thread_pool = {thread_pool_exec};
+
+static const void *plugin_get_extension(const clap_plugin_t *plugin,
+                                        const char *id) {
+  if (!strcmp(id, CLAP_EXT_AUDIO_PORTS)) {
+    return &audio_ports;
+  }
+  if (!strcmp(id, CLAP_EXT_PARAMS)) {
+    return &params;
+  }
+  if (!strcmp(id, CLAP_EXT_LATENCY)) {
+    return &latency;
+  }
+  if (!strcmp(id, CLAP_EXT_TAIL)) {
+    return &tail;
+  }
+  if (!strcmp(id, CLAP_EXT_STATE)) {
+    return &state;
+  }
+  if (!strcmp(id, CLAP_EXT_THREAD_POOL)) {
+    return &thread_pool;
+  }
+  return NULL;
+}
+
+static uint32_t factory_get_plugin_count(const clap_plugin_factory_t *factory) {
+  return NUMBER_OF_KINDS;
+}
+
+static const clap_plugin_descriptor_t *
+factory_get_plugin_descriptor(const clap_plugin_factory_t *factory,
+                              const uint32_t index) {
+  return index < NUMBER_OF_KINDS ? &kinds[index].descriptor : NULL;
+}
+
+static const clap_plugin_t *
+factory_create_plugin(const clap_plugin_factory_t *factory,
+                      const clap_host_t *host, const char *plugin_id) {
+  const ClapKind *kind = NULL;
+  for (uint32_t i = 0U; i < NUMBER_OF_KINDS && !kind; i++) {
+    if (!strcmp(plugin_id, kinds[i].descriptor.id)) {
+      kind = &kinds[i];
+    }
+  }
+  if (!kind) {
+    return NULL;
+  }
+
+  NoiseRepellentClap *self =
+      (NoiseRepellentClap *)calloc(1U, sizeof(NoiseRepellentClap));
+  if (!self) {
+    return NULL;
+  }
+
+  self->host = host;
+  self->kind = kind;
+  self->parameters = kind->adaptive ? adaptive_parameters : manual_parameters;
+  self->number_of_parameters =
+      kind->adaptive ? ADAPTIVE_PARAMETERS : MANUAL_PARAMETERS;
+  for (uint32_t i = 0U; i < self->number_of_parameters; i++) {
+    self->values[i] = self->parameters[i].default_value;
+  }
+
+  // clang-format off
+  self->plugin = (clap_plugin_t){
+      &kind->descriptor,
+      self,
+      plugin_init,
+      plugin_destroy,
+      plugin_activate,
+      plugin_deactivate,
+      plugin_start_processing,
+      plugin_stop_processing,
+      plugin_reset,
+      plugin_process,
+      plugin_get_extension,
+      plugin_on_main_thread
+  };
+  // clang-format on
+
+  return &self->plugin;
+}
+
+static const clap_plugin_factory_t factory = {factory_get_plugin_count,
+                                              factory_get_plugin_descriptor,
+                                              factory_create_plugin};
+
+static bool entry_init(const char *plugin_path) { return true; }
+
+static void entry_deinit(void) {}
+
+static const void *entry_get_factory(const char *factory_id) {
+  return strcmp(factory_id, CLAP_PLUGIN_FACTORY_ID) ? NULL : &factory;
+}
+
+CLAP_EXPORT const clap_plugin_entry_t clap_entry = {
+    CLAP_VERSION_INIT, entry_init, entry_deinit, entry_get_factory};
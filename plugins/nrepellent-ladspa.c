@@ -0,0 +1,458 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "../include/nrepellent.h"
+#include "../src/thread_pool.h"
+#include "../tools/render_state.h"
+#include <ladspa.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Profiles are the state files written by nrepellent-render --save-profile,
+// so they are looked up by the properties of the LV2 plugins
+#define NOISEREPELLENT_URI "https://github.com/lucianodato/noise-repellent#new"
+#define NOISEREPELLENT_STEREO_URI                                              \
+  "https://github.com/lucianodato/noise-repellent-stereo#new"
+
+#define PROFILE_ENV "NREPELLENT_PROFILE"
+#define WARM_START_SEED_ENV "NREPELLENT_ADAPTIVE_SEED"
+#define MAXIMUM_CHANNELS 2U
+#define PARALLEL_MINIMUM_SAMPLES 256U
+
+// Not registered with ladspa.org, hosts should go by the labels
+#define UNIQUE_ID_BASE 4790UL
+
+// Control ports keep the LV2 indexes up to the latency, the ones the LV2
+// plugin appends after its audio ports follow it. Audio ports come last.
+#define MANUAL_CONTROLS 14U
+#define MANUAL_LATENCY 11U
+#define MANUAL_NOISE_TRACKING 12U
+#define MANUAL_PROFILE_SLOT 13U
+#define ADAPTIVE_CONTROLS 9U
+#define ADAPTIVE_LATENCY 8U
+
+#define INPUT (LADSPA_PORT_INPUT | LADSPA_PORT_CONTROL)
+#define OUTPUT (LADSPA_PORT_OUTPUT | LADSPA_PORT_CONTROL)
+#define AUDIO_INPUT (LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO)
+#define AUDIO_OUTPUT (LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO)
+#define BOUNDED (LADSPA_HINT_BOUNDED_BELOW | LADSPA_HINT_BOUNDED_ABOVE)
+#define STEPPED (BOUNDED | LADSPA_HINT_INTEGER)
+#define TOGGLED (LADSPA_HINT_TOGGLED)
+
+// LADSPA defaults are fixed points of the range, the strength of 2 is
+// closest to the low one (3)
+// clang-format off
+static const LADSPA_PortDescriptor manual_port_descriptors[] = {
+    INPUT, INPUT, INPUT, INPUT, INPUT, INPUT, INPUT, INPUT, INPUT, INPUT,
+    INPUT, OUTPUT, INPUT, INPUT,
+    AUDIO_INPUT, AUDIO_OUTPUT, AUDIO_INPUT, AUDIO_OUTPUT,
+};
+
+static const char *const manual_port_names[] = {
+    "Learn noise profile", "Reduction amount", "Type of reduction",
+    "Reduction strength", "Post-filter threshold", "Smoothing",
+    "Residual whitening", "Protect Transients", "Residual listen",
+    "Reset noise profile", "Enable", "latency", "Track noise drift",
+    "Profile slot",
+    "Input L", "Output L", "Input R", "Output R",
+};
+
+static const LADSPA_PortRangeHint manual_port_hints[] = {
+    {STEPPED | LADSPA_HINT_DEFAULT_0, 0.F, 3.F},
+    {BOUNDED | LADSPA_HINT_DEFAULT_LOW, 0.F, 40.F},
+    {STEPPED | LADSPA_HINT_DEFAULT_MAXIMUM, 0.F, 2.F},
+    {BOUNDED | LADSPA_HINT_DEFAULT_LOW, 0.F, 12.F},
+    {BOUNDED | LADSPA_HINT_DEFAULT_MINIMUM, -10.F, 10.F},
+    {BOUNDED | LADSPA_HINT_DEFAULT_MINIMUM, 0.F, 100.F},
+    {BOUNDED | LADSPA_HINT_DEFAULT_MINIMUM, 0.F, 100.F},
+    {TOGGLED | LADSPA_HINT_DEFAULT_0, 0.F, 0.F},
+    {TOGGLED | LADSPA_HINT_DEFAULT_0, 0.F, 0.F},
+    {TOGGLED | LADSPA_HINT_DEFAULT_0, 0.F, 0.F},
+    {TOGGLED | LADSPA_HINT_DEFAULT_1, 0.F, 0.F},
+    {0, 0.F, 0.F},
+    {TOGGLED | LADSPA_HINT_DEFAULT_0, 0.F, 0.F},
+    {STEPPED | LADSPA_HINT_DEFAULT_0, 0.F, 99.F},
+    {0, 0.F, 0.F}, {0, 0.F, 0.F}, {0, 0.F, 0.F}, {0, 0.F, 0.F},
+};
+
+static const LADSPA_PortDescriptor adaptive_port_descriptors[] = {
+    INPUT, INPUT, INPUT, INPUT, INPUT, INPUT, INPUT, INPUT, OUTPUT,
+    AUDIO_INPUT, AUDIO_OUTPUT, AUDIO_INPUT, AUDIO_OUTPUT,
+};
+
+static const char *const adaptive_port_names[] = {
+    "Reduction amount", "Type of reduction", "Reduction strength",
+    "Post-filter threshold", "Smoothing", "Residual whitening",
+    "Residual listen", "Enable", "latency",
+    "Input L", "Output L", "Input R", "Output R",
+};
+
+static const LADSPA_PortRangeHint adaptive_port_hints[] = {
+    {BOUNDED | LADSPA_HINT_DEFAULT_MIDDLE, 0.F, 20.F},
+    {STEPPED | LADSPA_HINT_DEFAULT_MAXIMUM, 0.F, 2.F},
+    {BOUNDED | LADSPA_HINT_DEFAULT_LOW, 0.F, 12.F},
+    {BOUNDED | LADSPA_HINT_DEFAULT_MINIMUM, -10.F, 10.F},
+    {BOUNDED | LADSPA_HINT_DEFAULT_MINIMUM, 0.F, 100.F},
+    {BOUNDED | LADSPA_HINT_DEFAULT_MINIMUM, 0.F, 100.F},
+    {TOGGLED | LADSPA_HINT_DEFAULT_0, 0.F, 0.F},
+    {TOGGLED | LADSPA_HINT_DEFAULT_1, 0.F, 0.F},
+    {0, 0.F, 0.F},
+    {0, 0.F, 0.F}, {0, 0.F, 0.F}, {0, 0.F, 0.F}, {0, 0.F, 0.F},
+};
+// clang-format on
+
+typedef struct LadspaKind {
+  bool adaptive;
+  uint32_t channels;
+} LadspaKind;
+
+static const LadspaKind manual_mono = {false, 1U};
+static const LadspaKind manual_stereo = {false, 2U};
+static const LadspaKind adaptive_mono = {true, 1U};
+static const LadspaKind adaptive_stereo = {true, 2U};
+
+typedef struct NoiseRepellentLadspa {
+  const LadspaKind *kind;
+  uint32_t sample_rate;
+  uint32_t number_of_controls;
+
+  LADSPA_Data *controls[MANUAL_CONTROLS];
+  const LADSPA_Data *inputs[MAXIMUM_CHANNELS];
+  LADSPA_Data *outputs[MAXIMUM_CHANNELS];
+
+  NoiseRepellent *denoisers[MAXIMUM_CHANNELS];
+  NoiseRepellentAdaptive *adaptive_denoisers[MAXIMUM_CHANNELS];
+
+  ThreadPool *thread_pool;
+  ThreadPoolTask channel_2_task;
+  NoiseRepellentParameters parameters;
+  uint32_t number_of_samples;
+} NoiseRepellentLadspa;
+
+static void cleanup(LADSPA_Handle instance) {
+  NoiseRepellentLadspa *self = (NoiseRepellentLadspa *)instance;
+
+  for (uint32_t c = 0U; c < MAXIMUM_CHANNELS; c++) {
+    if (self->denoisers[c]) {
+      nrepellent_free(self->denoisers[c]);
+    }
+    if (self->adaptive_denoisers[c]) {
+      nrepellent_adaptive_free(self->adaptive_denoisers[c]);
+    }
+  }
+
+  if (self->thread_pool) {
+    thread_pool_release(self->thread_pool);
+  }
+
+  free(instance);
+}
+
+static void process_channel(NoiseRepellentLadspa *self, const uint32_t channel) {
+  if (self->kind->adaptive) {
+    nrepellent_adaptive_load_parameters(self->adaptive_denoisers[channel],
+                                        self->parameters);
+    nrepellent_adaptive_process(self->adaptive_denoisers[channel],
+                                self->number_of_samples, self->inputs[channel],
+                                self->outputs[channel]);
+  } else {
+    nrepellent_load_parameters(self->denoisers[channel], self->parameters);
+    nrepellent_process(self->denoisers[channel], self->number_of_samples,
+                       self->inputs[channel], self->outputs[channel]);
+  }
+}
+
+static void process_channel_2(void *context) {
+  process_channel((NoiseRepellentLadspa *)context, 1U);
+}
+
+static LADSPA_Handle instantiate(const LADSPA_Descriptor *descriptor,
+                                 const unsigned long sample_rate) {
+  NoiseRepellentLadspa *self =
+      (NoiseRepellentLadspa *)calloc(1U, sizeof(NoiseRepellentLadspa));
+  if (!self) {
+    return NULL;
+  }
+
+  self->kind = (const LadspaKind *)descriptor->ImplementationData;
+  self->sample_rate = (uint32_t)sample_rate;
+  self->number_of_controls =
+      self->kind->adaptive ? ADAPTIVE_CONTROLS : MANUAL_CONTROLS;
+
+  for (uint32_t c = 0U; c < self->kind->channels; c++) {
+    if (self->kind->adaptive) {
+      self->adaptive_denoisers[c] =
+          nrepellent_adaptive_initialize(self->sample_rate);
+    } else {
+      self->denoisers[c] = nrepellent_initialize(self->sample_rate);
+    }
+
+    if (!self->denoisers[c] && !self->adaptive_denoisers[c]) {
+      cleanup((LADSPA_Handle)self);
+      return NULL;
+    }
+  }
+
+  const char *seed_path = getenv(WARM_START_SEED_ENV);
+  for (uint32_t c = 0U; seed_path && self->kind->adaptive &&
+                        c < self->kind->channels;
+       c++) {
+    nrepellent_adaptive_load_noise_seed_file(self->adaptive_denoisers[c],
+                                             seed_path);
+  }
+
+  if (self->kind->channels == 2U) {
+    self->thread_pool = thread_pool_acquire(NULL, NULL);
+    thread_pool_task_initialize(&self->channel_2_task, process_channel_2,
+                                self);
+  }
+
+  return (LADSPA_Handle)self;
+}
+
+static void connect_port(LADSPA_Handle instance, const unsigned long port,
+                         LADSPA_Data *data) {
+  NoiseRepellentLadspa *self = (NoiseRepellentLadspa *)instance;
+
+  if (port < self->number_of_controls) {
+    self->controls[port] = data;
+    return;
+  }
+
+  const unsigned long audio_port = port - self->number_of_controls;
+  if (audio_port >= 2U * self->kind->channels) {
+    return;
+  }
+
+  if (audio_port % 2U == 0U) {
+    self->inputs[audio_port / 2U] = data;
+  } else {
+    self->outputs[audio_port / 2U] = data;
+  }
+}
+
+static const void *find_property(const RenderState *state,
+                                 const uint32_t instance, const char *suffix,
+                                 const size_t minimum_size) {
+  static const char *const prefixes[] = {NOISEREPELLENT_URI,
+                                         NOISEREPELLENT_STEREO_URI};
+  char key[256];
+
+  for (uint32_t i = 0U; i < sizeof(prefixes) / sizeof(prefixes[0]); i++) {
+    snprintf(key, sizeof(key), "%s%s", prefixes[i], suffix);
+
+    const char *type = NULL;
+    uint32_t flags = 0U;
+    size_t size = 0U;
+    const void *value =
+        render_state_get(state, instance, key, &type, &flags, &size);
+    if (value && size >= minimum_size) {
+      return value;
+    }
+  }
+
+  return NULL;
+}
+
+// A file learned on N mono channels holds one instance per channel, one
+// learned in stereo a single instance with both floors
+static bool load_channel_profile(NoiseRepellentLadspa *self,
+                                 const RenderState *state,
+                                 const uint32_t channel) {
+  const uint32_t profile_size =
+      nrepellent_get_noise_profile_size(self->denoisers[channel]);
+  const size_t stored_size = 2U * sizeof(uint32_t) + profile_size * sizeof(float);
+
+  uint32_t instance = channel;
+  if (!find_property(state, instance, "#noiseprofile", stored_size)) {
+    instance = 0U;
+  }
+
+  const uint32_t *size =
+      (const uint32_t *)find_property(state, instance, "#noiseprofilesize",
+                                      sizeof(uint32_t));
+  const uint32_t *averaged_blocks = (const uint32_t *)find_property(
+      state, instance, "#noiseprofileaveragedblocks", sizeof(uint32_t));
+  const char *profile = (const char *)find_property(
+      state, instance, "#noiseprofile", stored_size);
+  if (!size || !averaged_blocks || !profile || *size != profile_size) {
+    return false;
+  }
+
+  const float *floor = (const float *)find_property(
+      state, instance, channel == 0U ? "#noisefloor1" : "#noisefloor2",
+      sizeof(float));
+  if (!floor) {
+    floor = (const float *)find_property(state, instance, "#noisefloor",
+                                         sizeof(float));
+  }
+
+  // Stored as an LV2 Atom Vector body, the elements follow its header
+  return nrepellent_load_noise_profile(
+      self->denoisers[channel],
+      (const float *)(profile + 2U * sizeof(uint32_t)), profile_size,
+      *averaged_blocks, floor ? *floor : 0.F);
+}
+
+// Profile slot 0 reads NREPELLENT_PROFILE, slot n NREPELLENT_PROFILE_n, so
+// several instances of one process can use different profiles
+static void load_profile(NoiseRepellentLadspa *self) {
+  const LADSPA_Data *slot_port = self->controls[MANUAL_PROFILE_SLOT];
+  const long slot = slot_port ? lrintf(*slot_port) : 0L;
+
+  char name[32];
+  if (slot > 0L) {
+    snprintf(name, sizeof(name), PROFILE_ENV "_%ld", slot);
+  } else {
+    snprintf(name, sizeof(name), PROFILE_ENV);
+  }
+
+  const char *path = getenv(name);
+  if (!path || *path == '\0') {
+    return;
+  }
+
+  RenderState *state = render_state_load(path);
+  bool loaded = state != NULL;
+  for (uint32_t c = 0U; loaded && c < self->kind->channels; c++) {
+    loaded = load_channel_profile(self, state, c);
+  }
+
+  if (!loaded) {
+    fprintf(stderr, "nrepellent: cannot load the noise profile <%s>\n", path);
+  }
+
+  if (state) {
+    render_state_free(state);
+  }
+}
+
+static void activate(LADSPA_Handle instance) {
+  NoiseRepellentLadspa *self = (NoiseRepellentLadspa *)instance;
+
+  if (self->kind->adaptive) {
+    if (self->controls[ADAPTIVE_LATENCY]) {
+      *self->controls[ADAPTIVE_LATENCY] =
+          (float)nrepellent_adaptive_get_latency(self->adaptive_denoisers[0]);
+    }
+    return;
+  }
+
+  load_profile(self);
+
+  if (self->controls[MANUAL_LATENCY]) {
+    *self->controls[MANUAL_LATENCY] =
+        (float)nrepellent_get_latency(self->denoisers[0]);
+  }
+}
+
+static bool read_toggle(const NoiseRepellentLadspa *self, const uint32_t port) {
+  return *self->controls[port] > 0.F;
+}
+
+static NoiseRepellentParameters read_parameters(NoiseRepellentLadspa *self) {
+  LADSPA_Data *const *controls = self->controls;
+
+  // clang-format off
+  if (self->kind->adaptive) {
+    return (NoiseRepellentParameters){
+        .enable = read_toggle(self, 7U),
+        .residual_listen = read_toggle(self, 6U),
+        .reduction_amount = *controls[0],
+        .smoothing_factor = *controls[4],
+        .whitening_factor = *controls[5],
+        .noise_rescale = *controls[2],
+        .noise_scaling_type = (int)lrintf(*controls[1]),
+        .post_filter_threshold = *controls[3],
+    };
+  }
+
+  return (NoiseRepellentParameters){
+      .enable = read_toggle(self, 10U),
+      .learn_noise = (int)lrintf(*controls[0]),
+      .reset_noise_profile = read_toggle(self, 9U),
+      .noise_tracking = read_toggle(self, MANUAL_NOISE_TRACKING),
+      .residual_listen = read_toggle(self, 8U),
+      .transient_protection = read_toggle(self, 7U),
+      .noise_scaling_type = (int)lrintf(*controls[2]),
+      .reduction_amount = *controls[1],
+      .noise_rescale = *controls[3],
+      .smoothing_factor = *controls[5],
+      .whitening_factor = *controls[6],
+      .post_filter_threshold = *controls[4],
+  };
+  // clang-format on
+}
+
+static void run(LADSPA_Handle instance, const unsigned long sample_count) {
+  NoiseRepellentLadspa *self = (NoiseRepellentLadspa *)instance;
+  self->parameters = read_parameters(self);
+  self->number_of_samples = (uint32_t)sample_count;
+
+  if (self->kind->channels == 1U) {
+    process_channel(self, 0U);
+    return;
+  }
+
+  // Tiny blocks cost more to hand over than to process
+  if (self->number_of_samples >= PARALLEL_MINIMUM_SAMPLES) {
+    thread_pool_submit(self->thread_pool, &self->channel_2_task);
+  }
+
+  process_channel(self, 0U);
+
+  if (self->number_of_samples >= PARALLEL_MINIMUM_SAMPLES) {
+    thread_pool_wait(self->thread_pool, &self->channel_2_task);
+  } else {
+    process_channel_2(self);
+  }
+}
+
+#define DESCRIPTOR(id, label, name, ports, kind, data)                         \
+  {                                                                            \
+    UNIQUE_ID_BASE + (id), label, LADSPA_PROPERTY_HARD_RT_CAPABLE, name,       \
+        "Luciano Dato", "LGPL-3.0-or-later", ports, kind##_port_descriptors,   \
+        kind##_port_names, kind##_port_hints, (void *)(data), instantiate,     \
+        connect_port, activate, run, NULL, NULL, NULL, cleanup                 \
+  }
+
+// clang-format off
+static const LADSPA_Descriptor descriptors[] = {
+    DESCRIPTOR(0UL, "nrepellent", "Noise repellent",
+               MANUAL_CONTROLS + 2U, manual, &manual_mono),
+    DESCRIPTOR(1UL, "nrepellent_stereo", "Noise repellent Stereo",
+               MANUAL_CONTROLS + 4U, manual, &manual_stereo),
+    DESCRIPTOR(2UL, "nrepellent_adaptive", "Noise repellent Adaptive",
+               ADAPTIVE_CONTROLS + 2U, adaptive, &adaptive_mono),
+    DESCRIPTOR(3UL, "nrepellent_adaptive_stereo",
+               "Noise repellent Adaptive Stereo",
+               ADAPTIVE_CONTROLS + 4U, adaptive, &adaptive_stereo),
+};
+// clang-format on
+
+#define NUMBER_OF_DESCRIPTORS                                                  \
+  (unsigned long)(sizeof(descriptors) / sizeof(descriptors[0]))
+
+__attribute__((visibility("default"))) const LADSPA_Descriptor *
+ladspa_descriptor(const unsigned long index) {
+  return index < NUMBER_OF_DESCRIPTORS ? &descriptors[index] : NULL;
+}
@@ -0,0 +1,39 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "channel_layout.h"
+#include <stddef.h>
+
+// clang-format off
+static const ChannelLayout layouts[] = {
+    {"quad", 4U, CHANNEL_LAYOUT_NO_LFE},       // L R Ls Rs
+    {"surround51", 6U, 3U},                    // L R C LFE Ls Rs
+    {"surround71", 8U, 3U},                    // L R C LFE Ls Rs Lrs Rrs
+    {"foa", 4U, CHANNEL_LAYOUT_NO_LFE},        // W Y Z X
+};
+// clang-format on
+
+uint32_t channel_layout_get_count(void) {
+  return (uint32_t)(sizeof(layouts) / sizeof(layouts[0]));
+}
+
+const ChannelLayout *channel_layout_get(const uint32_t index) {
+  return index < channel_layout_get_count() ? &layouts[index] : NULL;
+}
@@ -0,0 +1,43 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef CHANNEL_LAYOUT_H
+#define CHANNEL_LAYOUT_H
+
+#include <stdint.h>
+
+#define CHANNEL_LAYOUT_MAXIMUM_CHANNELS 8U
+#define CHANNEL_LAYOUT_NO_LFE UINT32_MAX
+
+/*
+ * Layouts of the multichannel descriptors, listed after mono and stereo.
+ * Surround channels follow the WAV order and ambisonics AmbiX (ACN, SN3D),
+ * the TTL generated by meson.build lists the same ones.
+ */
+typedef struct ChannelLayout {
+  const char *name;
+  uint32_t number_of_channels;
+  uint32_t lfe_channel;
+} ChannelLayout;
+
+uint32_t channel_layout_get_count(void);
+const ChannelLayout *channel_layout_get(uint32_t index);
+
+#endif
@@ -0,0 +1,72 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "log_ring.h"
+#include "spsc_ring.h"
+#include <stdlib.h>
+
+struct LogRing {
+  SpscRing *records;
+  uint32_t dropped; // Added to by the writer, taken by the reader
+};
+
+LogRing *log_ring_initialize(const uint32_t capacity) {
+  LogRing *self = (LogRing *)calloc(1U, sizeof(LogRing));
+  if (!self) {
+    return NULL;
+  }
+
+  self->records = spsc_ring_initialize(capacity, sizeof(LogRecord));
+  if (!self->records) {
+    log_ring_free(self);
+    return NULL;
+  }
+
+  return self;
+}
+
+void log_ring_free(LogRing *self) {
+  if (self->records) {
+    spsc_ring_free(self->records);
+  }
+  free(self);
+}
+
+void log_ring_write(LogRing *self, const LogRingLevel level,
+                    const char *format, const double first,
+                    const double second) {
+  const LogRecord record = {level, format, {first, second}};
+
+  if (!spsc_ring_push(self->records, &record)) {
+    __atomic_fetch_add(&self->dropped, 1U, __ATOMIC_RELAXED);
+  }
+}
+
+bool log_ring_read(LogRing *self, LogRecord *record) {
+  return spsc_ring_pop(self->records, record);
+}
+
+uint32_t log_ring_get_count(const LogRing *self) {
+  return spsc_ring_get_count(self->records);
+}
+
+uint32_t log_ring_take_dropped(LogRing *self) {
+  return __atomic_exchange_n(&self->dropped, 0U, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,55 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum LogRingLevel {
+  LOG_RING_NOTE = 0,
+  LOG_RING_WARNING = 1,
+  LOG_RING_ERROR = 2,
+} LogRingLevel;
+
+// The format is a string literal taking up to two doubles, it's only
+// expanded once the record is read on a thread that may block
+typedef struct LogRecord {
+  LogRingLevel level;
+  const char *format;
+  double arguments[2];
+} LogRecord;
+
+/*
+ * Preallocated queue of log records from the realtime thread to the one
+ * printing them. Writing never blocks nor allocates, records that don't fit
+ * are counted and dropped. One writer and one reader at a time.
+ */
+typedef struct LogRing LogRing;
+
+LogRing *log_ring_initialize(uint32_t capacity);
+void log_ring_free(LogRing *self);
+void log_ring_write(LogRing *self, LogRingLevel level, const char *format,
+                    double first, double second);
+bool log_ring_read(LogRing *self, LogRecord *record);
+uint32_t log_ring_get_count(const LogRing *self);
+uint32_t log_ring_take_dropped(LogRing *self);
+#endif
@@ -0,0 +1,224 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "mid_side.h"
+#include "signal_crossfade.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define GAIN_TIME_MS 20.F
+#define SILENCE_ENERGY 1e-10F
+
+/*
+ * The side gain is the ratio of the mid energy after and before the
+ * denoiser, measured per block on the aligned signals and followed with a
+ * one pole smoother so block edges don't step. It never boosts the side.
+ *
+ * The delayed mid and side are kept here because the host may process in
+ * place.
+ */
+struct MidSide {
+  float smoothing;
+  float gain;
+
+  uint32_t latency;
+  uint32_t delay_position;
+  float *mid_delay;
+  float *side_delay;
+  float dry_mid[MID_SIDE_MAX_BLOCK];
+  float side[MID_SIDE_MAX_BLOCK];
+
+  // Mode the denoisers run in and the fades of the left and right outputs
+  bool active;
+  bool requested;
+  uint32_t refill; // Samples the delays and the denoiser hold stale audio
+  bool measured;   // Once the gain followed a block since turning on
+  SignalCrossfade *fades[2];
+};
+
+MidSide *mid_side_initialize(const uint32_t sample_rate,
+                             const uint32_t latency) {
+  MidSide *self = (MidSide *)calloc(1U, sizeof(MidSide));
+  if (!self) {
+    return NULL;
+  }
+
+  self->smoothing =
+      1.F - expf(-1.F / (GAIN_TIME_MS * (float)sample_rate / 1000.F));
+  self->gain = 1.F;
+
+  self->latency = latency;
+  if (latency > 0U) {
+    self->mid_delay = (float *)calloc(latency, sizeof(float));
+    self->side_delay = (float *)calloc(latency, sizeof(float));
+    if (!self->mid_delay || !self->side_delay) {
+      mid_side_free(self);
+      return NULL;
+    }
+  }
+
+  for (uint32_t c = 0U; c < 2U; c++) {
+    self->fades[c] = signal_crossfade_initialize(sample_rate, latency);
+    if (!self->fades[c]) {
+      mid_side_free(self);
+      return NULL;
+    }
+  }
+
+  return self;
+}
+
+void mid_side_free(MidSide *self) {
+  for (uint32_t c = 0U; c < 2U; c++) {
+    if (self->fades[c]) {
+      signal_crossfade_free(self->fades[c]);
+    }
+  }
+  free(self->mid_delay);
+  free(self->side_delay);
+  free(self);
+}
+
+bool mid_side_encode(MidSide *self, const uint32_t number_of_samples,
+                     const float *left, const float *right, float *mid) {
+  if (!left || !right || !mid || number_of_samples > MID_SIDE_MAX_BLOCK) {
+    return false;
+  }
+
+  for (uint32_t k = 0U; k < number_of_samples; k++) {
+    const float side = 0.5F * (left[k] - right[k]);
+    mid[k] = 0.5F * (left[k] + right[k]);
+
+    if (self->latency == 0U) {
+      self->dry_mid[k] = mid[k];
+      self->side[k] = side;
+      continue;
+    }
+
+    self->dry_mid[k] = self->mid_delay[self->delay_position];
+    self->side[k] = self->side_delay[self->delay_position];
+    self->mid_delay[self->delay_position] = mid[k];
+    self->side_delay[self->delay_position] = side;
+    self->delay_position = (self->delay_position + 1U) % self->latency;
+  }
+
+  return true;
+}
+
+bool mid_side_decode(MidSide *self, const uint32_t number_of_samples,
+                     const float *mid, float *left, float *right) {
+  if (!mid || !left || !right || number_of_samples > MID_SIDE_MAX_BLOCK) {
+    return false;
+  }
+
+  // Audio still stale after turning on says nothing about the reduction
+  const uint32_t stale =
+      self->refill < number_of_samples ? self->refill : number_of_samples;
+  self->refill -= stale;
+
+  float dry_energy = 0.F;
+  float wet_energy = 0.F;
+  for (uint32_t k = stale; k < number_of_samples; k++) {
+    dry_energy += self->dry_mid[k] * self->dry_mid[k];
+    wet_energy += mid[k] * mid[k];
+  }
+
+  // Nor does silence, the last gain is kept
+  float target = self->gain;
+  if (dry_energy > SILENCE_ENERGY * (float)(number_of_samples - stale)) {
+    target = fminf(sqrtf(wet_energy / dry_energy), 1.F);
+
+    // The first measure is taken as is, the output is still dry then
+    if (!self->measured) {
+      self->gain = target;
+      self->measured = true;
+    }
+  }
+
+  for (uint32_t k = 0U; k < number_of_samples; k++) {
+    self->gain += self->smoothing * (target - self->gain);
+
+    const float side = self->gain * self->side[k];
+    const float wet_mid = mid[k];
+    left[k] = wet_mid + side;
+    right[k] = wet_mid - side;
+  }
+
+  return true;
+}
+
+// Blocks of any size, called before the input may be overwritten
+bool mid_side_store_dry(MidSide *self, const uint32_t number_of_samples,
+                        const float *left, const float *right) {
+  if (!left || !right) {
+    return false;
+  }
+
+  for (uint32_t k = 0U; k < number_of_samples; k += MID_SIDE_MAX_BLOCK) {
+    const uint32_t block = number_of_samples - k < MID_SIDE_MAX_BLOCK
+                               ? number_of_samples - k
+                               : MID_SIDE_MAX_BLOCK;
+
+    signal_crossfade_store_dry(self->fades[0], block, &left[k]);
+    signal_crossfade_store_dry(self->fades[1], block, &right[k]);
+  }
+
+  return true;
+}
+
+bool mid_side_is_active(const MidSide *self) { return self->active; }
+
+// While true the block goes through mid_side_switch and mid_side_fade in
+// steps of at most MID_SIDE_MAX_BLOCK
+bool mid_side_is_switching(const MidSide *self, const bool requested) {
+  return requested != self->active ||
+         !signal_crossfade_is_settled(self->fades[0]);
+}
+
+// Stores the dry input of the step and returns the mode to process it in,
+// which only changes once the output faded to dry
+bool mid_side_switch(MidSide *self, const uint32_t number_of_samples,
+                     const float *left, const float *right,
+                     const bool requested) {
+  if (number_of_samples > MID_SIDE_MAX_BLOCK ||
+      !signal_crossfade_store_dry(self->fades[0], number_of_samples, left) ||
+      !signal_crossfade_store_dry(self->fades[1], number_of_samples, right)) {
+    return self->active;
+  }
+
+  if (requested != self->active &&
+      !signal_crossfade_is_wet(self->fades[0], false)) {
+    self->active = requested;
+    self->refill = requested ? self->latency : 0U;
+    self->measured = !requested;
+  }
+  self->requested = requested;
+
+  return self->active;
+}
+
+// Fades the processed step toward dry while the mode differs from the one
+// requested, and back to wet after the latency once they match
+bool mid_side_fade(MidSide *self, const uint32_t number_of_samples,
+                   float *left, float *right) {
+  const bool wet = self->requested == self->active;
+  return signal_crossfade_run(self->fades[0], number_of_samples, left, wet) &&
+         signal_crossfade_run(self->fades[1], number_of_samples, right, wet);
+}
@@ -0,0 +1,58 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef MID_SIDE_H
+#define MID_SIDE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Largest block accepted by mid_side_encode and mid_side_decode
+#define MID_SIDE_MAX_BLOCK 256U
+
+/*
+ * Mid/side path of the stereo plugins. Only the mid signal goes through a
+ * denoiser, the side is delayed by its latency and follows the broadband
+ * gain the denoiser applied to the mid.
+ *
+ * Switching the mode on or off fades the output to the dry left and right
+ * signals, changes the mode once there and fades back in after the latency.
+ * The denoisers refilling with their new input are never heard that way:
+ * the first one moves between left and mid, the second one sat idle during
+ * mid/side. The dry signals are fed every block so they are ready then.
+ */
+typedef struct MidSide MidSide;
+
+MidSide *mid_side_initialize(uint32_t sample_rate, uint32_t latency);
+void mid_side_free(MidSide *self);
+bool mid_side_encode(MidSide *self, uint32_t number_of_samples,
+                     const float *left, const float *right, float *mid);
+bool mid_side_decode(MidSide *self, uint32_t number_of_samples,
+                     const float *mid, float *left, float *right);
+bool mid_side_store_dry(MidSide *self, uint32_t number_of_samples,
+                        const float *left, const float *right);
+bool mid_side_is_active(const MidSide *self);
+bool mid_side_is_switching(const MidSide *self, bool requested);
+bool mid_side_switch(MidSide *self, uint32_t number_of_samples,
+                     const float *left, const float *right, bool requested);
+bool mid_side_fade(MidSide *self, uint32_t number_of_samples, float *left,
+                   float *right);
+
+#endif
@@ -0,0 +1,193 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "noise_profile_median.h"
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HISTOGRAM_BUCKETS 96U
+#define BUCKETS_PER_OCTAVE 4.F // 0.75 dB of power per bucket
+#define HISTOGRAM_CENTER ((float)HISTOGRAM_BUCKETS / 2.F)
+
+typedef union FloatBits {
+  float value;
+  uint32_t bits;
+} FloatBits;
+
+struct NoiseProfileMedian {
+  uint32_t profile_size;
+  uint32_t count;
+  uint32_t averaged_blocks;
+
+  float *previous_average;
+  float *frame;     // Log domain value of the last frame for every bin
+  float *origin;    // Log domain position of the first bucket for every bin
+  uint32_t *bucket; // Bucket hit by the last frame for every bin
+  uint32_t *histogram; // HISTOGRAM_BUCKETS rows of profile_size counters
+};
+
+// Piecewise linear log2 read straight from the float representation. It is
+// monotonic and exactly invertible, which is all an order statistic needs,
+// and unlike log2f it vectorizes as plain integer arithmetic.
+static inline float log2_approximate(const float value) {
+  FloatBits converter = {fmaxf(value, FLT_MIN)};
+  return (float)converter.bits * (1.F / 8388608.F) - 127.F;
+}
+
+static inline float exp2_approximate(const float value) {
+  FloatBits converter;
+  converter.bits =
+      (uint32_t)((fminf(fmaxf(value, -126.F), 127.F) + 127.F) * 8388608.F);
+  return converter.value;
+}
+
+NoiseProfileMedian *noise_profile_median_initialize(const uint32_t profile_size) {
+  NoiseProfileMedian *self =
+      (NoiseProfileMedian *)calloc(1U, sizeof(NoiseProfileMedian));
+  if (!self) {
+    return NULL;
+  }
+
+  self->profile_size = profile_size;
+  self->previous_average = (float *)calloc(profile_size, sizeof(float));
+  self->frame = (float *)calloc(profile_size, sizeof(float));
+  self->origin = (float *)calloc(profile_size, sizeof(float));
+  self->bucket = (uint32_t *)calloc(profile_size, sizeof(uint32_t));
+  self->histogram = (uint32_t *)calloc(
+      (size_t)HISTOGRAM_BUCKETS * profile_size, sizeof(uint32_t));
+
+  if (!self->previous_average || !self->frame || !self->origin ||
+      !self->bucket || !self->histogram) {
+    noise_profile_median_free(self);
+    return NULL;
+  }
+
+  return self;
+}
+
+void noise_profile_median_free(NoiseProfileMedian *self) {
+  free(self->previous_average);
+  free(self->frame);
+  free(self->origin);
+  free(self->bucket);
+  free(self->histogram);
+  free(self);
+}
+
+void noise_profile_median_reset(NoiseProfileMedian *self, const float *average,
+                                const uint32_t averaged_blocks) {
+  self->count = 0U;
+  self->averaged_blocks = average ? averaged_blocks : 0U;
+
+  if (average) {
+    memcpy(self->previous_average, average,
+           sizeof(float) * self->profile_size);
+  } else {
+    memset(self->previous_average, 0, sizeof(float) * self->profile_size);
+  }
+
+  memset(self->histogram, 0,
+         sizeof(uint32_t) * HISTOGRAM_BUCKETS * self->profile_size);
+}
+
+bool noise_profile_median_update(NoiseProfileMedian *self,
+                                 const float *average,
+                                 const uint32_t averaged_blocks) {
+  if (!average || averaged_blocks <= self->averaged_blocks) {
+    return false;
+  }
+
+  const uint32_t size = self->profile_size;
+  const uint32_t new_blocks = averaged_blocks - self->averaged_blocks;
+  const float current_weight = (float)averaged_blocks / (float)new_blocks;
+  const float previous_weight =
+      (float)self->averaged_blocks / (float)new_blocks;
+
+  // Undo the running mean to get the mean of the frames averaged since the
+  // last call. When the host block spans several frames they enter the
+  // histogram together with their combined weight.
+  for (uint32_t k = 0U; k < size; k++) {
+    self->frame[k] = log2_approximate(current_weight * average[k] -
+                                      previous_weight *
+                                          self->previous_average[k]);
+  }
+
+  if (self->count == 0U) {
+    for (uint32_t k = 0U; k < size; k++) {
+      self->origin[k] = self->frame[k] - HISTOGRAM_CENTER / BUCKETS_PER_OCTAVE;
+    }
+  }
+
+  for (uint32_t k = 0U; k < size; k++) {
+    const float position =
+        (self->frame[k] - self->origin[k]) * BUCKETS_PER_OCTAVE;
+    self->bucket[k] = (uint32_t)fminf(
+        fmaxf(position, 0.F), (float)(HISTOGRAM_BUCKETS - 1U));
+  }
+
+  // Every bin owns its own column, so the scatter never collides
+  for (uint32_t k = 0U; k < size; k++) {
+    self->histogram[self->bucket[k] * size + k] += new_blocks;
+  }
+
+  memcpy(self->previous_average, average, sizeof(float) * size);
+  self->averaged_blocks = averaged_blocks;
+  self->count += new_blocks;
+
+  return true;
+}
+
+bool noise_profile_median_get(const NoiseProfileMedian *self, float *median) {
+  if (!median || self->count == 0U) {
+    return false;
+  }
+
+  const uint32_t size = self->profile_size;
+  const float half = 0.5F * (float)self->count;
+
+  for (uint32_t k = 0U; k < size; k++) {
+    uint32_t cumulative = 0U;
+    uint32_t bucket = 0U;
+
+    for (; bucket < HISTOGRAM_BUCKETS - 1U; bucket++) {
+      const uint32_t hits = self->histogram[bucket * size + k];
+      if ((float)(cumulative + hits) >= half) {
+        break;
+      }
+      cumulative += hits;
+    }
+
+    // Interpolate linearly inside the bucket that crosses the half count
+    const uint32_t hits = self->histogram[bucket * size + k];
+    const float fraction =
+        hits > 0U ? (half - (float)cumulative) / (float)hits : 0.5F;
+
+    median[k] = exp2_approximate(
+        self->origin[k] + ((float)bucket + fraction) / BUCKETS_PER_OCTAVE);
+  }
+
+  return true;
+}
+
+uint32_t noise_profile_median_get_count(const NoiseProfileMedian *self) {
+  return self->count;
+}
@@ -0,0 +1,48 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef NOISE_PROFILE_MEDIAN_H
+#define NOISE_PROFILE_MEDIAN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Bounded memory streaming median of the noise spectrum. Each bin keeps a
+ * fixed size histogram in the log domain, so memory is O(bins) and every
+ * learned frame costs the same regardless of how long the capture is.
+ *
+ * Frames are recovered from the running mean libspecbleach keeps while
+ * learning (Average of Noise), which lets the median be learned without a
+ * second STFT.
+ */
+typedef struct NoiseProfileMedian NoiseProfileMedian;
+
+NoiseProfileMedian *noise_profile_median_initialize(uint32_t profile_size);
+void noise_profile_median_free(NoiseProfileMedian *self);
+void noise_profile_median_reset(NoiseProfileMedian *self, const float *average,
+                                uint32_t averaged_blocks);
+bool noise_profile_median_update(NoiseProfileMedian *self,
+                                 const float *average,
+                                 uint32_t averaged_blocks);
+bool noise_profile_median_get(const NoiseProfileMedian *self, float *median);
+uint32_t noise_profile_median_get_count(const NoiseProfileMedian *self);
+
+#endif
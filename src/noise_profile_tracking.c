@@ -0,0 +1,222 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "noise_profile_tracking.h"
+#include "simd_kernels.h"
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SUBFRAME_MS 10.F
+#define SMOOTHING_TIME_MS 60.F
+#define SUBFRAMES_PER_WINDOW 24U // 240 ms per minimum search window
+#define MINIMUM_WINDOWS 8U       // So the floor remembers about 2 seconds
+#define MAXIMUM_DRIFT_DB 12.F
+#define DRIFT_STEP_DB 0.5F
+
+struct NoiseProfileTracking {
+  const SimdKernels *kernels;
+
+  uint32_t profile_size;
+  float *prior;
+  float *profile;
+  bool prior_available;
+  float reference_floor;
+  float applied_gain;
+
+  uint32_t subframe_length;
+  uint32_t subframe_position;
+  float subframe_energy;
+  float smoothing;
+  float smoothed_power;
+  bool smoothed_power_available;
+
+  uint32_t subframe_count;
+  float window_minimum;
+  float minima[MINIMUM_WINDOWS];
+  uint32_t minima_index;
+  uint32_t minima_filled;
+};
+
+NoiseProfileTracking *
+noise_profile_tracking_initialize(const uint32_t sample_rate,
+                                  const uint32_t profile_size) {
+  NoiseProfileTracking *self =
+      (NoiseProfileTracking *)calloc(1U, sizeof(NoiseProfileTracking));
+  if (!self) {
+    return NULL;
+  }
+
+  self->kernels = simd_kernels_get();
+  self->profile_size = profile_size;
+  self->prior = (float *)calloc(profile_size, sizeof(float));
+  self->profile = (float *)calloc(profile_size, sizeof(float));
+
+  if (!self->prior || !self->profile) {
+    noise_profile_tracking_free(self);
+    return NULL;
+  }
+
+  self->subframe_length =
+      (uint32_t)((float)sample_rate * SUBFRAME_MS / 1000.F);
+  if (self->subframe_length == 0U) {
+    self->subframe_length = 1U;
+  }
+  self->smoothing = expf(-SUBFRAME_MS / SMOOTHING_TIME_MS);
+  self->window_minimum = FLT_MAX;
+  self->applied_gain = 1.F;
+
+  return self;
+}
+
+void noise_profile_tracking_free(NoiseProfileTracking *self) {
+  free(self->prior);
+  free(self->profile);
+  free(self);
+}
+
+static void noise_profile_tracking_end_subframe(NoiseProfileTracking *self) {
+  const float power = self->subframe_energy / (float)self->subframe_length;
+
+  if (self->smoothed_power_available) {
+    self->smoothed_power = self->smoothing * self->smoothed_power +
+                           (1.F - self->smoothing) * power;
+  } else {
+    self->smoothed_power = power;
+    self->smoothed_power_available = true;
+  }
+
+  self->window_minimum = fminf(self->window_minimum, self->smoothed_power);
+
+  if (++self->subframe_count == SUBFRAMES_PER_WINDOW) {
+    self->minima[self->minima_index] = self->window_minimum;
+    self->minima_index = (self->minima_index + 1U) % MINIMUM_WINDOWS;
+    if (self->minima_filled < MINIMUM_WINDOWS) {
+      self->minima_filled++;
+    }
+
+    self->window_minimum = FLT_MAX;
+    self->subframe_count = 0U;
+  }
+
+  self->subframe_energy = 0.F;
+  self->subframe_position = 0U;
+}
+
+void noise_profile_tracking_run(NoiseProfileTracking *self,
+                                const uint32_t number_of_samples,
+                                const float *input) {
+  uint32_t k = 0U;
+
+  while (k < number_of_samples) {
+    const uint32_t remaining = self->subframe_length - self->subframe_position;
+    const uint32_t chunk = number_of_samples - k < remaining
+                               ? number_of_samples - k
+                               : remaining;
+
+    self->subframe_energy += self->kernels->sum_of_squares(&input[k], chunk);
+    self->subframe_position += chunk;
+    k += chunk;
+
+    if (self->subframe_position == self->subframe_length) {
+      noise_profile_tracking_end_subframe(self);
+    }
+  }
+}
+
+float noise_profile_tracking_get_floor(const NoiseProfileTracking *self) {
+  if (self->minima_filled == 0U) {
+    return 0.F;
+  }
+
+  float noise_floor = self->window_minimum;
+  for (uint32_t i = 0U; i < self->minima_filled; i++) {
+    noise_floor = fminf(noise_floor, self->minima[i]);
+  }
+
+  return noise_floor;
+}
+
+void noise_profile_tracking_set_prior(NoiseProfileTracking *self,
+                                      const float *prior,
+                                      const float reference_floor) {
+  memcpy(self->prior, prior, sizeof(float) * self->profile_size);
+  self->prior_available = true;
+  self->reference_floor = reference_floor;
+  self->applied_gain = 1.F;
+}
+
+void noise_profile_tracking_clear_prior(NoiseProfileTracking *self) {
+  self->prior_available = false;
+  self->reference_floor = 0.F;
+  self->applied_gain = 1.F;
+}
+
+const float *noise_profile_tracking_get_prior(NoiseProfileTracking *self) {
+  return self->prior_available ? self->prior : NULL;
+}
+
+float noise_profile_tracking_get_reference(const NoiseProfileTracking *self) {
+  return self->reference_floor;
+}
+
+float *noise_profile_tracking_update(NoiseProfileTracking *self) {
+  if (!self->prior_available) {
+    return NULL;
+  }
+
+  const float noise_floor = noise_profile_tracking_get_floor(self);
+  if (noise_floor <= 0.F) {
+    return NULL;
+  }
+
+  // The prior was captured before the floor could be measured, so the first
+  // valid floor becomes its reference
+  if (self->reference_floor <= 0.F) {
+    self->reference_floor = noise_floor;
+    return NULL;
+  }
+
+  const float maximum_gain = powf(10.F, MAXIMUM_DRIFT_DB / 10.F);
+  const float gain =
+      fminf(fmaxf(noise_floor / self->reference_floor, 1.F / maximum_gain),
+            maximum_gain);
+
+  if (fabsf(10.F * log10f(gain / self->applied_gain)) < DRIFT_STEP_DB) {
+    return NULL;
+  }
+
+  // Profiles are power spectra, same as the floor
+  self->kernels->apply_gain(self->prior, gain, self->profile,
+                            self->profile_size);
+  self->applied_gain = gain;
+
+  return self->profile;
+}
+
+float *noise_profile_tracking_release(NoiseProfileTracking *self) {
+  if (!self->prior_available || self->applied_gain == 1.F) {
+    return NULL;
+  }
+
+  self->applied_gain = 1.F;
+  return self->prior;
+}
@@ -0,0 +1,51 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef NOISE_PROFILE_TRACKING_H
+#define NOISE_PROFILE_TRACKING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Follows slow drift of the noise floor around a captured profile. The
+ * captured profile acts as a prior and the level of the floor is tracked
+ * with minimum statistics on the time domain input, so the rescaled prior
+ * can be loaded back into the same denoiser without a second STFT.
+ */
+typedef struct NoiseProfileTracking NoiseProfileTracking;
+
+NoiseProfileTracking *noise_profile_tracking_initialize(uint32_t sample_rate,
+                                                        uint32_t profile_size);
+void noise_profile_tracking_free(NoiseProfileTracking *self);
+void noise_profile_tracking_run(NoiseProfileTracking *self,
+                                uint32_t number_of_samples,
+                                const float *input);
+void noise_profile_tracking_set_prior(NoiseProfileTracking *self,
+                                      const float *prior,
+                                      float reference_floor);
+void noise_profile_tracking_clear_prior(NoiseProfileTracking *self);
+const float *noise_profile_tracking_get_prior(NoiseProfileTracking *self);
+float noise_profile_tracking_get_floor(const NoiseProfileTracking *self);
+float noise_profile_tracking_get_reference(const NoiseProfileTracking *self);
+float *noise_profile_tracking_update(NoiseProfileTracking *self);
+float *noise_profile_tracking_release(NoiseProfileTracking *self);
+
+#endif
@@ -0,0 +1,294 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "../include/nrepellent.h"
+#include "noise_profile_median.h"
+#include "noise_profile_tracking.h"
+#include "signal_crossfade.h"
+#include "specbleach_denoiser.h"
+#include "usdt_probes.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME_SIZE 46
+#define FRAME_OVERLAP 4U // Hops per frame in libspecbleach
+
+struct NoiseRepellent {
+  SpectralBleachHandle lib_instance;
+  SignalCrossfade *soft_bypass;
+  NoiseProfileMedian *median_profile;
+  NoiseProfileTracking *profile_tracking;
+  float *noise_profile;
+  uint32_t profile_size;
+  uint32_t hop_size; // Longest block adding at most one frame to the mean
+
+  NoiseRepellentParameters parameters;
+  int learn_mode;
+  int previous_learn_mode;
+};
+
+NoiseRepellent *nrepellent_initialize(const uint32_t sample_rate) {
+  NoiseRepellent *self = (NoiseRepellent *)calloc(1U, sizeof(NoiseRepellent));
+  if (!self) {
+    return NULL;
+  }
+
+  self->lib_instance = specbleach_initialize(sample_rate, FRAME_SIZE);
+  if (!self->lib_instance) {
+    nrepellent_free(self);
+    return NULL;
+  }
+
+  self->soft_bypass = signal_crossfade_initialize(
+      sample_rate, specbleach_get_latency(self->lib_instance));
+
+  self->hop_size = specbleach_get_latency(self->lib_instance) / FRAME_OVERLAP;
+  if (self->hop_size == 0U || self->hop_size > SIGNAL_CROSSFADE_MAX_BLOCK) {
+    self->hop_size = SIGNAL_CROSSFADE_MAX_BLOCK;
+  }
+
+  self->profile_size = specbleach_get_noise_profile_size(self->lib_instance);
+  self->noise_profile = (float *)calloc(self->profile_size, sizeof(float));
+  self->median_profile = noise_profile_median_initialize(self->profile_size);
+  self->profile_tracking =
+      noise_profile_tracking_initialize(sample_rate, self->profile_size);
+
+  if (!self->soft_bypass || !self->noise_profile || !self->median_profile ||
+      !self->profile_tracking) {
+    nrepellent_free(self);
+    return NULL;
+  }
+
+  return self;
+}
+
+void nrepellent_free(NoiseRepellent *self) {
+  if (self->median_profile) {
+    noise_profile_median_free(self->median_profile);
+  }
+
+  if (self->profile_tracking) {
+    noise_profile_tracking_free(self->profile_tracking);
+  }
+
+  if (self->lib_instance) {
+    specbleach_free(self->lib_instance);
+  }
+
+  if (self->soft_bypass) {
+    signal_crossfade_free(self->soft_bypass);
+  }
+
+  free(self->noise_profile);
+  free(self);
+}
+
+uint32_t nrepellent_get_latency(const NoiseRepellent *self) {
+  return specbleach_get_latency(self->lib_instance);
+}
+
+void nrepellent_load_parameters(NoiseRepellent *self,
+                                const NoiseRepellentParameters parameters) {
+  self->parameters = parameters;
+}
+
+// Median of Noise is learned here rather than in libspecbleach. The library
+// keeps learning its running mean and every new frame is recovered from it
+// into a bounded histogram, so long captures don't grow memory nor CPU.
+static void prepare_median_learning(NoiseRepellent *self) {
+  const bool was_learning =
+      self->previous_learn_mode == NREPELLENT_LEARN_MEDIAN;
+  const bool is_learning = self->learn_mode == NREPELLENT_LEARN_MEDIAN;
+
+  if (was_learning && !is_learning &&
+      noise_profile_median_get(self->median_profile, self->noise_profile)) {
+    specbleach_load_noise_profile(
+        self->lib_instance, self->noise_profile, self->profile_size,
+        specbleach_get_noise_profile_blocks_averaged(self->lib_instance));
+  }
+
+  if (is_learning &&
+      (!was_learning || self->parameters.reset_noise_profile)) {
+    noise_profile_median_reset(
+        self->median_profile, specbleach_get_noise_profile(self->lib_instance),
+        specbleach_get_noise_profile_blocks_averaged(self->lib_instance));
+  }
+}
+
+static void update_median_learning(NoiseRepellent *self) {
+  if (self->learn_mode != NREPELLENT_LEARN_MEDIAN) {
+    return;
+  }
+
+  noise_profile_median_update(
+      self->median_profile, specbleach_get_noise_profile(self->lib_instance),
+      specbleach_get_noise_profile_blocks_averaged(self->lib_instance));
+}
+
+// Hybrid mode. The captured profile is kept as a prior and the drift of the
+// noise floor is followed in the time domain, so the rescaled prior is
+// loaded into the same denoiser instead of chaining an adaptive one.
+static void track_noise_profile(NoiseRepellent *self,
+                                const uint32_t number_of_samples,
+                                const float *input) {
+  if (self->parameters.reset_noise_profile) {
+    noise_profile_tracking_clear_prior(self->profile_tracking);
+  }
+
+  noise_profile_tracking_run(self->profile_tracking, number_of_samples,
+                             input);
+
+  if (self->previous_learn_mode != NREPELLENT_LEARN_OFF &&
+      self->learn_mode == NREPELLENT_LEARN_OFF &&
+      specbleach_noise_profile_available(self->lib_instance)) {
+    noise_profile_tracking_set_prior(
+        self->profile_tracking,
+        specbleach_get_noise_profile(self->lib_instance),
+        noise_profile_tracking_get_floor(self->profile_tracking));
+  }
+
+  float *noise_profile =
+      self->parameters.noise_tracking &&
+              self->learn_mode == NREPELLENT_LEARN_OFF
+          ? noise_profile_tracking_update(self->profile_tracking)
+          : noise_profile_tracking_release(self->profile_tracking);
+
+  if (noise_profile) {
+    specbleach_load_noise_profile(
+        self->lib_instance, noise_profile, self->profile_size,
+        specbleach_get_noise_profile_blocks_averaged(self->lib_instance));
+  }
+}
+
+// Runs the denoiser through the soft bypass in blocks it can hold. While
+// fully bypassed the denoiser is skipped and the aligned dry signal copied.
+// Median learning goes hop by hop so every frame enters the histogram on
+// its own instead of averaged with the rest of a long host block.
+static void process_channel(NoiseRepellent *self,
+                            const uint32_t number_of_samples,
+                            const float *input, float *output) {
+  const bool enable = self->parameters.enable;
+  const uint32_t step = self->learn_mode == NREPELLENT_LEARN_MEDIAN
+                            ? self->hop_size
+                            : SIGNAL_CROSSFADE_MAX_BLOCK;
+
+  for (uint32_t k = 0U; k < number_of_samples; k += step) {
+    const uint32_t block =
+        number_of_samples - k < step ? number_of_samples - k : step;
+
+    signal_crossfade_store_dry(self->soft_bypass, block, &input[k]);
+
+    if (signal_crossfade_is_wet(self->soft_bypass, enable)) {
+      specbleach_process(self->lib_instance, block, &input[k], &output[k]);
+    }
+
+    signal_crossfade_run(self->soft_bypass, block, &output[k], enable);
+    update_median_learning(self);
+  }
+}
+
+void nrepellent_process(NoiseRepellent *self,
+                        const uint32_t number_of_samples, const float *input,
+                        float *output) {
+  self->previous_learn_mode = self->learn_mode;
+  self->learn_mode = self->parameters.learn_noise;
+
+  if (self->previous_learn_mode == NREPELLENT_LEARN_OFF &&
+      self->learn_mode != NREPELLENT_LEARN_OFF) {
+    USDT_PROBE2(learn_start, self, self->learn_mode);
+  } else if (self->previous_learn_mode != NREPELLENT_LEARN_OFF &&
+             self->learn_mode == NREPELLENT_LEARN_OFF) {
+    USDT_PROBE2(
+        learn_stop, self,
+        specbleach_get_noise_profile_blocks_averaged(self->lib_instance));
+  }
+
+  // clang-format off
+  const SpectralBleachParameters parameters = {
+      .learn_noise = self->learn_mode == NREPELLENT_LEARN_MEDIAN
+                         ? NREPELLENT_LEARN_AVERAGE
+                         : self->learn_mode,
+      .residual_listen = self->parameters.residual_listen,
+      .noise_scaling_type = self->parameters.noise_scaling_type,
+      .transient_protection = self->parameters.transient_protection,
+      .reduction_amount = self->parameters.reduction_amount,
+      .noise_rescale = self->parameters.noise_rescale,
+      .smoothing_factor = self->parameters.smoothing_factor,
+      .whitening_factor = self->parameters.whitening_factor,
+      .post_filter_threshold = self->parameters.post_filter_threshold,
+  };
+  // clang-format on
+
+  specbleach_load_parameters(self->lib_instance, parameters);
+
+  if (self->parameters.reset_noise_profile) {
+    USDT_PROBE1(profile_reset, self);
+    specbleach_reset_noise_profile(self->lib_instance);
+  }
+
+  prepare_median_learning(self);
+  track_noise_profile(self, number_of_samples, input);
+  process_channel(self, number_of_samples, input, output);
+}
+
+uint32_t nrepellent_get_noise_profile_size(const NoiseRepellent *self) {
+  return self->profile_size;
+}
+
+bool nrepellent_noise_profile_available(NoiseRepellent *self) {
+  return specbleach_noise_profile_available(self->lib_instance);
+}
+
+// While tracking drift the library holds a rescaled profile, the captured
+// one is what gets returned
+bool nrepellent_get_noise_profile(NoiseRepellent *self, float *profile,
+                                  uint32_t *averaged_blocks,
+                                  float *noise_floor) {
+  const float *prior = noise_profile_tracking_get_prior(self->profile_tracking);
+  memcpy(profile,
+         prior ? prior : specbleach_get_noise_profile(self->lib_instance),
+         sizeof(float) * self->profile_size);
+
+  *averaged_blocks =
+      specbleach_get_noise_profile_blocks_averaged(self->lib_instance);
+  *noise_floor = noise_profile_tracking_get_reference(self->profile_tracking);
+
+  return specbleach_noise_profile_available(self->lib_instance);
+}
+
+// A floor of zero gets measured from the next input, as for profiles saved
+// before drift tracking
+bool nrepellent_load_noise_profile(NoiseRepellent *self, const float *profile,
+                                   const uint32_t profile_size,
+                                   const uint32_t averaged_blocks,
+                                   const float noise_floor) {
+  if (profile_size != self->profile_size) {
+    return false;
+  }
+
+  memcpy(self->noise_profile, profile, sizeof(float) * self->profile_size);
+
+  const bool loaded = specbleach_load_noise_profile(
+      self->lib_instance, self->noise_profile, profile_size, averaged_blocks);
+  noise_profile_tracking_set_prior(self->profile_tracking, self->noise_profile,
+                                   noise_floor);
+
+  return loaded;
+}
@@ -0,0 +1,197 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "../include/nrepellent.h"
+#include "signal_crossfade.h"
+#include "signal_history.h"
+#include "specbleach_adenoiser.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME_SIZE 36
+#define WARM_START_LENGTH_MS 2000.F
+#define WARM_START_BLOCK 1024U
+
+struct NoiseRepellentAdaptive {
+  SpectralBleachHandle lib_instance;
+  SignalCrossfade *soft_bypass;
+  SignalHistory *noise_seed;
+  NoiseRepellentParameters parameters;
+  float warm_start_output[WARM_START_BLOCK];
+  uint32_t warm_start_mute;
+};
+
+NoiseRepellentAdaptive *nrepellent_adaptive_initialize(
+    const uint32_t sample_rate) {
+  NoiseRepellentAdaptive *self =
+      (NoiseRepellentAdaptive *)calloc(1U, sizeof(NoiseRepellentAdaptive));
+  if (!self) {
+    return NULL;
+  }
+
+  self->lib_instance = specbleach_adaptive_initialize(sample_rate, FRAME_SIZE);
+  if (!self->lib_instance) {
+    nrepellent_adaptive_free(self);
+    return NULL;
+  }
+
+  self->noise_seed =
+      signal_history_initialize(sample_rate, WARM_START_LENGTH_MS);
+  self->soft_bypass = signal_crossfade_initialize(
+      sample_rate, specbleach_adaptive_get_latency(self->lib_instance));
+
+  if (!self->noise_seed || !self->soft_bypass) {
+    nrepellent_adaptive_free(self);
+    return NULL;
+  }
+
+  return self;
+}
+
+void nrepellent_adaptive_free(NoiseRepellentAdaptive *self) {
+  if (self->lib_instance) {
+    specbleach_adaptive_free(self->lib_instance);
+  }
+
+  if (self->noise_seed) {
+    signal_history_free(self->noise_seed);
+  }
+
+  if (self->soft_bypass) {
+    signal_crossfade_free(self->soft_bypass);
+  }
+
+  free(self);
+}
+
+uint32_t nrepellent_adaptive_get_latency(const NoiseRepellentAdaptive *self) {
+  return specbleach_adaptive_get_latency(self->lib_instance);
+}
+
+void nrepellent_adaptive_load_parameters(
+    NoiseRepellentAdaptive *self, const NoiseRepellentParameters parameters) {
+  self->parameters = parameters;
+}
+
+// Runs the denoiser through the soft bypass in blocks it can hold. While
+// fully bypassed the denoiser is skipped and the aligned dry signal copied.
+static void process_channel(NoiseRepellentAdaptive *self,
+                            const uint32_t number_of_samples,
+                            const float *input, float *output) {
+  const bool enable = self->parameters.enable;
+
+  for (uint32_t k = 0U; k < number_of_samples;
+       k += SIGNAL_CROSSFADE_MAX_BLOCK) {
+    const uint32_t block = number_of_samples - k < SIGNAL_CROSSFADE_MAX_BLOCK
+                               ? number_of_samples - k
+                               : SIGNAL_CROSSFADE_MAX_BLOCK;
+
+    signal_crossfade_store_dry(self->soft_bypass, block, &input[k]);
+
+    if (signal_crossfade_is_wet(self->soft_bypass, enable)) {
+      specbleach_adaptive_process(self->lib_instance, block, &input[k],
+                                  &output[k]);
+
+      // The replayed seed still buffered by the STFT
+      if (self->warm_start_mute > 0U) {
+        const uint32_t muted =
+            block < self->warm_start_mute ? block : self->warm_start_mute;
+        memset(&output[k], 0, sizeof(float) * muted);
+        self->warm_start_mute -= muted;
+      }
+    }
+
+    signal_crossfade_run(self->soft_bypass, block, &output[k], enable);
+  }
+}
+
+void nrepellent_adaptive_process(NoiseRepellentAdaptive *self,
+                                 const uint32_t number_of_samples,
+                                 const float *input, float *output) {
+  // clang-format off
+  const SpectralBleachParameters parameters = {
+      .residual_listen = self->parameters.residual_listen,
+      .reduction_amount = self->parameters.reduction_amount,
+      .smoothing_factor = self->parameters.smoothing_factor,
+      .whitening_factor = self->parameters.whitening_factor,
+      .noise_rescale = self->parameters.noise_rescale,
+      .noise_scaling_type = self->parameters.noise_scaling_type,
+      .post_filter_threshold = self->parameters.post_filter_threshold,
+  };
+  // clang-format on
+
+  specbleach_adaptive_load_parameters(self->lib_instance, parameters);
+
+  signal_history_push(self->noise_seed, number_of_samples, input);
+
+  process_channel(self, number_of_samples, input, output);
+}
+
+// libspecbleach can't export the adaptive estimator state, so the last input
+// seen is kept instead and replayed through the estimator to converge it
+// before the first block. The replayed output is discarded and so is the
+// tail still buffered by the STFT, muted like the first latency of a fresh
+// instance.
+static void warm_start(NoiseRepellentAdaptive *self) {
+  uint32_t number_of_samples = 0U;
+  const float *samples =
+      signal_history_get_samples(self->noise_seed, &number_of_samples);
+
+  for (uint32_t k = 0U; k < number_of_samples; k += WARM_START_BLOCK) {
+    const uint32_t block = number_of_samples - k < WARM_START_BLOCK
+                               ? number_of_samples - k
+                               : WARM_START_BLOCK;
+    specbleach_adaptive_process(self->lib_instance, block, &samples[k],
+                                self->warm_start_output);
+  }
+
+  self->warm_start_mute = number_of_samples > 0U
+                              ? specbleach_adaptive_get_latency(
+                                    self->lib_instance)
+                              : 0U;
+}
+
+const float *nrepellent_adaptive_get_noise_seed(NoiseRepellentAdaptive *self,
+                                                uint32_t *number_of_samples) {
+  return signal_history_get_samples(self->noise_seed, number_of_samples);
+}
+
+bool nrepellent_adaptive_load_noise_seed(NoiseRepellentAdaptive *self,
+                                         const float *samples,
+                                         const uint32_t number_of_samples) {
+  if (!signal_history_load(self->noise_seed, samples, number_of_samples)) {
+    return false;
+  }
+
+  warm_start(self);
+  return true;
+}
+
+// Raw native float samples at the denoiser sample rate, e.g. a recording of
+// the room tone
+bool nrepellent_adaptive_load_noise_seed_file(NoiseRepellentAdaptive *self,
+                                              const char *path) {
+  if (!signal_history_load_file(self->noise_seed, path)) {
+    return false;
+  }
+
+  warm_start(self);
+  return true;
+}
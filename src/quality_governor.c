@@ -0,0 +1,139 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "quality_governor.h"
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define ATTACK_SECONDS 0.05F
+#define RELEASE_SECONDS 0.5F
+#define STEP_DOWN_HOLD_SECONDS 0.25F
+#define STEP_UP_HOLD_SECONDS 2.F
+#define POSTFILTER_OFF -10.F
+
+/*
+ * The load of a block is the time spent processing it over the time it
+ * lasts. It is followed with a short attack and a slow release: a lone late
+ * block is mostly the host being preempted, which a cheaper level can't
+ * help, while a load that holds for a few tens of milliseconds is ours.
+ *
+ * The level steps down once the load goes over the maximum and back up when
+ * it stays under half of it for a while. Both wait for the load measured
+ * since the last step, so a new level gets judged on its own cost.
+ */
+struct QualityGovernor {
+  float sample_rate;
+  float maximum_load;
+
+  struct timespec start;
+  float load;
+  float held_seconds;
+  uint32_t level;
+};
+
+QualityGovernor *quality_governor_initialize(const uint32_t sample_rate,
+                                             const float maximum_load) {
+  if (sample_rate == 0U) {
+    return NULL;
+  }
+
+  QualityGovernor *self =
+      (QualityGovernor *)calloc(1U, sizeof(QualityGovernor));
+  if (!self) {
+    return NULL;
+  }
+
+  self->sample_rate = (float)sample_rate;
+  self->maximum_load = maximum_load;
+  self->level = QUALITY_GOVERNOR_FULL;
+
+  return self;
+}
+
+void quality_governor_free(QualityGovernor *self) { free(self); }
+
+void quality_governor_start(QualityGovernor *self) {
+  if (self->maximum_load > 0.F) {
+    clock_gettime(CLOCK_MONOTONIC, &self->start);
+  }
+}
+
+static void step(QualityGovernor *self, const uint32_t level) {
+  self->level = level;
+  self->load = 0.F;
+  self->held_seconds = 0.F;
+}
+
+uint32_t quality_governor_stop(QualityGovernor *self,
+                               const uint32_t number_of_samples) {
+  if (self->maximum_load <= 0.F || number_of_samples == 0U) {
+    return self->level;
+  }
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  const float elapsed = (float)(now.tv_sec - self->start.tv_sec) +
+                        (float)(now.tv_nsec - self->start.tv_nsec) * 1e-9F;
+  const float duration = (float)number_of_samples / self->sample_rate;
+  const float load = elapsed / duration;
+
+  const float time_constant =
+      load > self->load ? ATTACK_SECONDS : RELEASE_SECONDS;
+  self->load += (load - self->load) * (1.F - expf(-duration / time_constant));
+  self->held_seconds += duration;
+
+  if (self->load > self->maximum_load &&
+      self->level > QUALITY_GOVERNOR_MINIMAL &&
+      self->held_seconds >= STEP_DOWN_HOLD_SECONDS) {
+    step(self, self->level - 1U);
+  } else if (self->load < 0.5F * self->maximum_load &&
+             self->level < QUALITY_GOVERNOR_FULL &&
+             self->held_seconds >= STEP_UP_HOLD_SECONDS) {
+    step(self, self->level + 1U);
+  }
+
+  return self->level;
+}
+
+uint32_t quality_governor_get_level(const QualityGovernor *self) {
+  return self->level;
+}
+
+// The post-filter and transient protection go first, then the masking
+// model is traded for the plainer scalings and the smoothing dropped
+void quality_governor_apply(const uint32_t level,
+                            NoiseRepellentParameters *parameters) {
+  if (level < QUALITY_GOVERNOR_FULL) {
+    parameters->transient_protection = false;
+    parameters->post_filter_threshold = POSTFILTER_OFF;
+  }
+  if (level < QUALITY_GOVERNOR_FULL - 1U &&
+      parameters->noise_scaling_type > 1) {
+    parameters->noise_scaling_type = 1;
+  }
+  if (level == QUALITY_GOVERNOR_MINIMAL) {
+    parameters->noise_scaling_type = 0;
+    parameters->smoothing_factor = 0.F;
+  }
+}
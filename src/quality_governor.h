@@ -0,0 +1,47 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef QUALITY_GOVERNOR_H
+#define QUALITY_GOVERNOR_H
+
+#include "../include/nrepellent.h"
+#include <stdint.h>
+
+// Quality levels, every one below full is cheaper than the one above
+#define QUALITY_GOVERNOR_FULL 3U
+#define QUALITY_GOVERNOR_MINIMAL 0U
+
+// Host feature of offline renders, which keep full quality so their output
+// doesn't depend on how fast the machine is
+#define QUALITY_GOVERNOR_OFFLINE_URI                                           \
+  "https://github.com/lucianodato/noise-repellent#offline"
+
+typedef struct QualityGovernor QualityGovernor;
+
+QualityGovernor *quality_governor_initialize(uint32_t sample_rate,
+                                             float maximum_load);
+void quality_governor_free(QualityGovernor *self);
+void quality_governor_start(QualityGovernor *self);
+uint32_t quality_governor_stop(QualityGovernor *self,
+                               uint32_t number_of_samples);
+uint32_t quality_governor_get_level(const QualityGovernor *self);
+void quality_governor_apply(uint32_t level,
+                            NoiseRepellentParameters *parameters);
+#endif
@@ -0,0 +1,118 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "run_counters.h"
+#include <stdlib.h>
+#include <time.h>
+
+#define WINDOW_SECONDS 0.5F
+
+/*
+ * Times are summed over windows of half a second of audio and reported
+ * when one closes, so the ports read steadily. Blocks and skipped frames
+ * count from the start.
+ *
+ * Without NREPELLENT_RUN_COUNTERS nothing is measured and every report
+ * stays at zero.
+ */
+struct RunCounters {
+  float sample_rate;
+
+  struct timespec start;
+  float window_time;
+  float window_maximum_time;
+  float window_duration;
+  uint32_t window_blocks;
+  uint64_t blocks;
+  uint64_t skipped_frames;
+
+  float reports[RUN_COUNTERS_REPORTS];
+};
+
+RunCounters *run_counters_initialize(const uint32_t sample_rate) {
+  if (sample_rate == 0U) {
+    return NULL;
+  }
+
+  RunCounters *self = (RunCounters *)calloc(1U, sizeof(RunCounters));
+  if (!self) {
+    return NULL;
+  }
+
+  self->sample_rate = (float)sample_rate;
+
+  return self;
+}
+
+void run_counters_free(RunCounters *self) { free(self); }
+
+void run_counters_start(RunCounters *self) {
+#ifdef NREPELLENT_RUN_COUNTERS
+  clock_gettime(CLOCK_MONOTONIC, &self->start);
+#endif
+}
+
+#ifdef NREPELLENT_RUN_COUNTERS
+static void close_window(RunCounters *self) {
+  self->reports[RUN_COUNTERS_AVERAGE_TIME] =
+      self->window_time / (float)self->window_blocks * 1e6F;
+  self->reports[RUN_COUNTERS_MAXIMUM_TIME] = self->window_maximum_time * 1e6F;
+  self->reports[RUN_COUNTERS_LOAD] =
+      self->window_time / self->window_duration * 100.F;
+
+  self->window_time = 0.F;
+  self->window_maximum_time = 0.F;
+  self->window_duration = 0.F;
+  self->window_blocks = 0U;
+}
+#endif
+
+void run_counters_stop(RunCounters *self, const uint32_t number_of_samples,
+                       const uint32_t skipped_frames) {
+#ifdef NREPELLENT_RUN_COUNTERS
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  const float elapsed = (float)(now.tv_sec - self->start.tv_sec) +
+                        (float)(now.tv_nsec - self->start.tv_nsec) * 1e-9F;
+
+  self->window_time += elapsed;
+  if (elapsed > self->window_maximum_time) {
+    self->window_maximum_time = elapsed;
+  }
+  self->window_duration += (float)number_of_samples / self->sample_rate;
+  self->window_blocks++;
+
+  self->blocks++;
+  self->skipped_frames += skipped_frames;
+  self->reports[RUN_COUNTERS_BLOCKS] = (float)self->blocks;
+  self->reports[RUN_COUNTERS_SKIPPED_FRAMES] = (float)self->skipped_frames;
+
+  if (self->window_duration >= WINDOW_SECONDS) {
+    close_window(self);
+  }
+#endif
+}
+
+const float *run_counters_get_reports(const RunCounters *self) {
+  return self->reports;
+}
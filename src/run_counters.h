@@ -0,0 +1,45 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef RUN_COUNTERS_H
+#define RUN_COUNTERS_H
+
+#include <stdint.h>
+
+// Reports in the order of the plugin output ports. Times are in
+// microseconds, the load in percent of the block duration.
+typedef enum RunCountersReport {
+  RUN_COUNTERS_AVERAGE_TIME = 0,
+  RUN_COUNTERS_MAXIMUM_TIME = 1,
+  RUN_COUNTERS_LOAD = 2,
+  RUN_COUNTERS_BLOCKS = 3,
+  RUN_COUNTERS_SKIPPED_FRAMES = 4,
+  RUN_COUNTERS_REPORTS = 5,
+} RunCountersReport;
+
+typedef struct RunCounters RunCounters;
+
+RunCounters *run_counters_initialize(uint32_t sample_rate);
+void run_counters_free(RunCounters *self);
+void run_counters_start(RunCounters *self);
+void run_counters_stop(RunCounters *self, uint32_t number_of_samples,
+                       uint32_t skipped_frames);
+const float *run_counters_get_reports(const RunCounters *self);
+#endif
@@ -0,0 +1,190 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "run_histogram.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SUB_BUCKET_BITS 4U
+#define SUB_BUCKETS (1U << SUB_BUCKET_BITS)
+#define BINS ((32U - SUB_BUCKET_BITS + 1U) * SUB_BUCKETS)
+
+typedef struct LogHistogram {
+  uint64_t bins[BINS];
+  uint64_t count;
+  double sum;
+  uint32_t minimum;
+  uint32_t maximum;
+} LogHistogram;
+
+struct RunHistogram {
+  struct timespec start;
+  LogHistogram durations;
+  LogHistogram block_sizes;
+};
+
+// Values under 2 * SUB_BUCKETS get a bin each, above that every power of
+// two is split in SUB_BUCKETS equal bins
+static uint32_t get_bin(const uint32_t value) {
+  if (value < 2U * SUB_BUCKETS) {
+    return value;
+  }
+
+  uint32_t exponent = 0U;
+  while (value >> (exponent + 1U)) {
+    exponent++;
+  }
+  const uint32_t shift = exponent - SUB_BUCKET_BITS;
+
+  return (shift + 1U) * SUB_BUCKETS + (value >> shift) - SUB_BUCKETS;
+}
+
+static uint64_t get_bin_minimum(const uint32_t bin) {
+  if (bin < 2U * SUB_BUCKETS) {
+    return bin;
+  }
+
+  const uint32_t shift = bin / SUB_BUCKETS - 1U;
+  return (uint64_t)(SUB_BUCKETS + bin % SUB_BUCKETS) << shift;
+}
+
+static uint64_t get_bin_maximum(const uint32_t bin) {
+  return bin + 1U < BINS ? get_bin_minimum(bin + 1U) - 1U : UINT32_MAX;
+}
+
+static void record(LogHistogram *histogram, const uint32_t value) {
+  histogram->bins[get_bin(value)]++;
+  histogram->sum += (double)value;
+  if (histogram->count == 0U || value < histogram->minimum) {
+    histogram->minimum = value;
+  }
+  if (value > histogram->maximum) {
+    histogram->maximum = value;
+  }
+  histogram->count++;
+}
+
+RunHistogram *run_histogram_initialize(void) {
+  return (RunHistogram *)calloc(1U, sizeof(RunHistogram));
+}
+
+void run_histogram_free(RunHistogram *self) { free(self); }
+
+void run_histogram_start(RunHistogram *self) {
+  clock_gettime(CLOCK_MONOTONIC, &self->start);
+}
+
+void run_histogram_stop(RunHistogram *self,
+                        const uint32_t number_of_samples) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  const int64_t elapsed =
+      (int64_t)(now.tv_sec - self->start.tv_sec) * 1000000000 +
+      (int64_t)(now.tv_nsec - self->start.tv_nsec);
+
+  record(&self->durations,
+         elapsed > (int64_t)UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed);
+  record(&self->block_sizes, number_of_samples);
+}
+
+// Upper bound of the bin holding the given fraction of the values
+static uint64_t get_percentile(const LogHistogram *histogram,
+                               const double fraction) {
+  const double target = fraction * (double)histogram->count;
+
+  uint64_t seen = 0U;
+  for (uint32_t bin = 0U; bin < BINS; bin++) {
+    seen += histogram->bins[bin];
+    if (histogram->bins[bin] > 0U && (double)seen >= target) {
+      return get_bin_maximum(bin) < histogram->maximum
+                 ? get_bin_maximum(bin)
+                 : histogram->maximum;
+    }
+  }
+
+  return histogram->maximum;
+}
+
+static void write_histogram(FILE *file, const LogHistogram *histogram) {
+  fprintf(file,
+          "{\"count\":%llu,\"min\":%u,\"max\":%u,\"mean\":%.1f,"
+          "\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"p999\":%llu,\"bins\":[",
+          (unsigned long long)histogram->count, histogram->minimum,
+          histogram->maximum,
+          histogram->count > 0U ? histogram->sum / (double)histogram->count
+                                : 0.,
+          (unsigned long long)get_percentile(histogram, 0.5),
+          (unsigned long long)get_percentile(histogram, 0.9),
+          (unsigned long long)get_percentile(histogram, 0.99),
+          (unsigned long long)get_percentile(histogram, 0.999));
+
+  const char *separator = "";
+  for (uint32_t bin = 0U; bin < BINS; bin++) {
+    if (histogram->bins[bin] > 0U) {
+      fprintf(file, "%s[%llu,%llu,%llu]", separator,
+              (unsigned long long)get_bin_minimum(bin),
+              (unsigned long long)get_bin_maximum(bin),
+              (unsigned long long)histogram->bins[bin]);
+      separator = ",";
+    }
+  }
+
+  fputs("]}", file);
+}
+
+// One JSON object per line and instance, appended so every instance of a
+// session can share the file. Bins are [lowest, highest, count]. The line
+// goes out in a single write so concurrent writers never interleave.
+bool run_histogram_write(const RunHistogram *self, const char *path,
+                         const char *plugin_uri, const uint32_t sample_rate) {
+  char *record = NULL;
+  size_t length = 0U;
+  FILE *buffer = open_memstream(&record, &length);
+  if (!buffer) {
+    return false;
+  }
+
+  fprintf(buffer, "{\"plugin\":\"%s\",\"sample_rate\":%u,\"run_ns\":",
+          plugin_uri, (unsigned int)sample_rate);
+  write_histogram(buffer, &self->durations);
+  fputs(",\"block_size\":", buffer);
+  write_histogram(buffer, &self->block_sizes);
+  fputs("}\n", buffer);
+
+  if (fclose(buffer) != 0) {
+    free(record);
+    return false;
+  }
+
+  const int file = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+  bool written = file >= 0 && write(file, record, length) == (ssize_t)length;
+  if (file >= 0) {
+    written = close(file) == 0 && written;
+  }
+  free(record);
+
+  return written;
+}
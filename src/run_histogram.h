@@ -0,0 +1,40 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef RUN_HISTOGRAM_H
+#define RUN_HISTOGRAM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Log binned histograms of the run() duration in nanoseconds and of the
+ * block sizes, with 16 linear bins per power of two as in HdrHistogram.
+ * Recording never allocates, the JSON is written once at the end.
+ */
+typedef struct RunHistogram RunHistogram;
+
+RunHistogram *run_histogram_initialize(void);
+void run_histogram_free(RunHistogram *self);
+void run_histogram_start(RunHistogram *self);
+void run_histogram_stop(RunHistogram *self, uint32_t number_of_samples);
+bool run_histogram_write(const RunHistogram *self, const char *path,
+                         const char *plugin_uri, uint32_t sample_rate);
+#endif
@@ -19,59 +19,156 @@ Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 
 #include "signal_crossfade.h"
+#include "simd_kernels.h"
 #include <float.h>
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
-#ifndef M_PI
-#define M_PI 3.1415926535F
-#endif
-
-#define RELEASE_TIME_MS 30.F
+#define CROSSFADE_TIME_MS 30.F
+#define SETTLED_DISTANCE 1e-3F // The ramp is over once within -60 dB
 
+/*
+ * The wet gain is target - distance and the distance decays exponentially
+ * per sample, reaching SETTLED_DISTANCE after CROSSFADE_TIME_MS whatever the
+ * host block size is. Once settled the mix short-circuits to a no-op (wet)
+ * or a copy of the dry signal (bypassed).
+ *
+ * The dry signal is delayed by the latency of the processing so both sides
+ * stay aligned, and it is kept here because the host may process in place.
+ */
 struct SignalCrossfade {
-  float tau;
-  float wet_dry_target;
-  float wet_dry;
+  const SimdKernels *kernels;
+  float decay;
+  float target;
+  float distance;
+
+  uint32_t latency;
+  uint32_t hold;
+  uint32_t delay_position;
+  float *delay;
+  float dry[SIGNAL_CROSSFADE_MAX_BLOCK];
 };
 
-SignalCrossfade *signal_crossfade_initialize(const uint32_t sample_rate) {
+SignalCrossfade *signal_crossfade_initialize(const uint32_t sample_rate,
+                                             const uint32_t latency) {
   SignalCrossfade *self =
       (SignalCrossfade *)calloc(1U, sizeof(SignalCrossfade));
+  if (!self) {
+    return NULL;
+  }
 
-  self->tau =
-      (1.F - expf(-128.F * M_PI * RELEASE_TIME_MS / (float)sample_rate));
-  self->wet_dry = 0.F;
-  self->wet_dry_target = 0.F;
+  self->kernels = simd_kernels_get();
+  self->decay = expf(logf(SETTLED_DISTANCE) /
+                     (CROSSFADE_TIME_MS * (float)sample_rate / 1000.F));
+  self->target = 1.F;
+  self->distance = 0.F;
+
+  self->latency = latency;
+  if (latency > 0U) {
+    self->delay = (float *)calloc(latency, sizeof(float));
+    if (!self->delay) {
+      signal_crossfade_free(self);
+      return NULL;
+    }
+  }
 
   return self;
 }
 
-void signal_crossfade_free(SignalCrossfade *self) { free(self); }
+void signal_crossfade_free(SignalCrossfade *self) {
+  free(self->delay);
+  free(self);
+}
+
+bool signal_crossfade_store_dry(SignalCrossfade *self,
+                                const uint32_t number_of_samples,
+                                const float *input) {
+  if (!input || number_of_samples > SIGNAL_CROSSFADE_MAX_BLOCK) {
+    return false;
+  }
+
+  if (self->latency == 0U) {
+    memcpy(self->dry, input, sizeof(float) * number_of_samples);
+    return true;
+  }
+
+  uint32_t k = 0U;
+  while (k < number_of_samples) {
+    const uint32_t available = self->latency - self->delay_position;
+    const uint32_t chunk = number_of_samples - k < available
+                               ? number_of_samples - k
+                               : available;
+
+    memcpy(&self->dry[k], &self->delay[self->delay_position],
+           sizeof(float) * chunk);
+    memcpy(&self->delay[self->delay_position], &input[k],
+           sizeof(float) * chunk);
+
+    self->delay_position = (self->delay_position + chunk) % self->latency;
+    k += chunk;
+  }
+
+  return true;
+}
+
+bool signal_crossfade_is_wet(const SignalCrossfade *self, const bool enable) {
+  return enable || self->target - self->distance != 0.F;
+}
+
+// No ramp nor hold left, the output is fully wet or fully dry
+bool signal_crossfade_is_settled(const SignalCrossfade *self) {
+  return self->distance == 0.F && self->hold == 0U;
+}
 
-static void signal_crossfade_update_wetdry_target(SignalCrossfade *self,
-                                                  const bool enable) {
-  if (enable) {
-    self->wet_dry_target = 1.F;
-  } else {
-    self->wet_dry_target = 0.F;
+static void signal_crossfade_update_target(SignalCrossfade *self,
+                                           const bool enable) {
+  const float target = enable ? 1.F : 0.F;
+  if (target == self->target) {
+    return;
   }
 
-  self->wet_dry += self->tau * (self->wet_dry_target - self->wet_dry);
+  const float wet_gain = self->target - self->distance;
+
+  // Processing was skipped while fully bypassed, so the wet signal holds
+  // stale audio until the latency worth of fresh input went through
+  self->hold = enable && wet_gain == 0.F ? self->latency : 0U;
+
+  self->target = target;
+  self->distance = target - wet_gain;
 }
 
 bool signal_crossfade_run(SignalCrossfade *self,
-                          const uint32_t number_of_samples, const float *input,
-                          float *output, const bool enable) {
-  if (!input || !output || number_of_samples <= 0U) {
+                          const uint32_t number_of_samples, float *output,
+                          const bool enable) {
+  if (!output || number_of_samples == 0U ||
+      number_of_samples > SIGNAL_CROSSFADE_MAX_BLOCK) {
     return false;
   }
 
-  signal_crossfade_update_wetdry_target(self, enable);
+  signal_crossfade_update_target(self, enable);
+
+  uint32_t k = 0U;
+  if (self->hold > 0U) {
+    k = self->hold < number_of_samples ? self->hold : number_of_samples;
+    memcpy(output, self->dry, sizeof(float) * k);
+    self->hold -= k;
+  }
+
+  if (self->distance == 0.F) {
+    if (self->target == 0.F) {
+      memcpy(&output[k], &self->dry[k], sizeof(float) * (number_of_samples - k));
+    }
+    return true;
+  }
+
+  self->distance =
+      self->kernels->crossfade(&self->dry[k], &output[k], self->target,
+                               self->distance, self->decay,
+                               number_of_samples - k);
 
-  for (uint32_t k = 0U; k < number_of_samples; k++) {
-    output[k] = (1.F - self->wet_dry) * input[k] + output[k] * self->wet_dry;
+  if (fabsf(self->distance) < SETTLED_DISTANCE) {
+    self->distance = 0.F;
   }
 
   return true;
@@ -24,10 +24,18 @@ Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <stdbool.h>
 #include <stdint.h>
 
+// Largest block accepted by signal_crossfade_store_dry and run
+#define SIGNAL_CROSSFADE_MAX_BLOCK 256U
+
 typedef struct SignalCrossfade SignalCrossfade;
 
-SignalCrossfade *signal_crossfade_initialize(uint32_t sample_rate);
+SignalCrossfade *signal_crossfade_initialize(uint32_t sample_rate,
+                                             uint32_t latency);
 void signal_crossfade_free(SignalCrossfade *self);
+bool signal_crossfade_store_dry(SignalCrossfade *self,
+                                uint32_t number_of_samples, const float *input);
+bool signal_crossfade_is_wet(const SignalCrossfade *self, bool enable);
+bool signal_crossfade_is_settled(const SignalCrossfade *self);
 bool signal_crossfade_run(SignalCrossfade *self, uint32_t number_of_samples,
-                          const float *input, float *output, bool enable);
+                          float *output, bool enable);
 #endif
@@ -0,0 +1,185 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "signal_history.h"
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The ring is written from the audio thread while a save may read it from
+// another one. Both take the busy flag, but the audio thread only tries and
+// drops the block when a reader holds it, which leaves a gap in the history
+// and never makes it wait.
+struct SignalHistory {
+  uint32_t busy;
+  uint32_t length;
+  uint32_t filled;
+  uint32_t write_position;
+  float *ring;
+  float *samples;
+};
+
+SignalHistory *signal_history_initialize(const uint32_t sample_rate,
+                                         const float length_ms) {
+  SignalHistory *self = (SignalHistory *)calloc(1U, sizeof(SignalHistory));
+  if (!self) {
+    return NULL;
+  }
+
+  self->length = (uint32_t)((float)sample_rate * length_ms / 1000.F);
+  if (self->length == 0U) {
+    self->length = 1U;
+  }
+
+  self->ring = (float *)calloc(self->length, sizeof(float));
+  self->samples = (float *)calloc(self->length, sizeof(float));
+
+  if (!self->ring || !self->samples) {
+    signal_history_free(self);
+    return NULL;
+  }
+
+  return self;
+}
+
+void signal_history_free(SignalHistory *self) {
+  free(self->ring);
+  free(self->samples);
+  free(self);
+}
+
+static void signal_history_write(SignalHistory *self,
+                                 const uint32_t number_of_samples,
+                                 const float *input) {
+  uint32_t samples = number_of_samples;
+
+  // Only the last length samples can survive
+  if (samples > self->length) {
+    input += samples - self->length;
+    samples = self->length;
+  }
+
+  const uint32_t first = self->length - self->write_position < samples
+                             ? self->length - self->write_position
+                             : samples;
+
+  memcpy(&self->ring[self->write_position], input, sizeof(float) * first);
+  memcpy(self->ring, &input[first], sizeof(float) * (samples - first));
+
+  self->write_position = (self->write_position + samples) % self->length;
+  self->filled =
+      self->filled + samples > self->length ? self->length
+                                            : self->filled + samples;
+}
+
+void signal_history_push(SignalHistory *self,
+                         const uint32_t number_of_samples,
+                         const float *input) {
+  if (!input || number_of_samples == 0U ||
+      __atomic_exchange_n(&self->busy, 1U, __ATOMIC_ACQUIRE)) {
+    return;
+  }
+
+  signal_history_write(self, number_of_samples, input);
+  __atomic_store_n(&self->busy, 0U, __ATOMIC_RELEASE);
+}
+
+static void signal_history_lock(SignalHistory *self) {
+  while (__atomic_exchange_n(&self->busy, 1U, __ATOMIC_ACQUIRE)) {
+    sched_yield();
+  }
+}
+
+static void signal_history_unlock(SignalHistory *self) {
+  __atomic_store_n(&self->busy, 0U, __ATOMIC_RELEASE);
+}
+
+static void signal_history_linearize(SignalHistory *self) {
+  const uint32_t start =
+      (self->write_position + self->length - self->filled) % self->length;
+  const uint32_t first = self->length - start < self->filled
+                             ? self->length - start
+                             : self->filled;
+
+  memcpy(self->samples, &self->ring[start], sizeof(float) * first);
+  memcpy(&self->samples[first], self->ring,
+         sizeof(float) * (self->filled - first));
+}
+
+const float *signal_history_get_samples(SignalHistory *self,
+                                        uint32_t *number_of_samples) {
+  signal_history_lock(self);
+  signal_history_linearize(self);
+  *number_of_samples = self->filled;
+  signal_history_unlock(self);
+
+  return self->samples;
+}
+
+bool signal_history_load(SignalHistory *self, const float *samples,
+                         const uint32_t number_of_samples) {
+  if (!samples) {
+    return false;
+  }
+
+  signal_history_lock(self);
+  self->filled = 0U;
+  self->write_position = 0U;
+  if (number_of_samples > 0U) {
+    signal_history_write(self, number_of_samples, samples);
+  }
+  signal_history_unlock(self);
+
+  return true;
+}
+
+bool signal_history_load_file(SignalHistory *self, const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    return false;
+  }
+
+  // Raw native float samples at the plugin rate. Only the tail is kept.
+  long offset = 0L;
+  if (fseek(file, 0L, SEEK_END) == 0) {
+    const long bytes = ftell(file);
+    const long wanted = (long)(sizeof(float) * self->length);
+    offset = bytes > wanted ? bytes - wanted : 0L;
+    offset -= offset % (long)sizeof(float);
+  }
+
+  if (fseek(file, offset, SEEK_SET) != 0) {
+    fclose(file);
+    return false;
+  }
+
+  signal_history_lock(self);
+  const size_t samples = fread(self->ring, sizeof(float), self->length, file);
+  self->filled = (uint32_t)samples;
+  self->write_position = (uint32_t)samples % self->length;
+  signal_history_unlock(self);
+
+  fclose(file);
+
+  return samples > 0U;
+}
@@ -0,0 +1,47 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef SIGNAL_HISTORY_H
+#define SIGNAL_HISTORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Keeps the most recent input of a channel so it can be saved with the
+ * session and replayed through an estimator that has no state of its own to
+ * export. Pushing from the audio thread never waits, the samples can be read
+ * from another thread meanwhile.
+ */
+typedef struct SignalHistory SignalHistory;
+
+SignalHistory *signal_history_initialize(uint32_t sample_rate,
+                                         float length_ms);
+void signal_history_free(SignalHistory *self);
+void signal_history_push(SignalHistory *self, uint32_t number_of_samples,
+                         const float *input);
+const float *signal_history_get_samples(SignalHistory *self,
+                                        uint32_t *number_of_samples);
+bool signal_history_load(SignalHistory *self, const float *samples,
+                         uint32_t number_of_samples);
+bool signal_history_load_file(SignalHistory *self, const char *path);
+
+#endif
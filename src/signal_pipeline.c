@@ -0,0 +1,157 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "signal_pipeline.h"
+#include "spsc_ring.h"
+#include <stdlib.h>
+
+typedef struct PipelineChannel {
+  SpscRing *input;
+  SpscRing *output;
+  float input_chunk[SIGNAL_PIPELINE_CHUNK];
+  float output_chunk[SIGNAL_PIPELINE_CHUNK];
+} PipelineChannel;
+
+// The rings are sized so neither end ever finds them full: the worker is
+// done with the previous block before the next one is pushed
+struct SignalPipeline {
+  uint32_t latency;
+  uint32_t number_of_channels;
+  PipelineChannel *channels;
+};
+
+SignalPipeline *signal_pipeline_initialize(const uint32_t number_of_channels,
+                                           const uint32_t latency) {
+  if (number_of_channels == 0U || latency > SIGNAL_PIPELINE_MAX_LATENCY) {
+    return NULL;
+  }
+
+  SignalPipeline *self = (SignalPipeline *)calloc(1U, sizeof(SignalPipeline));
+  if (!self) {
+    return NULL;
+  }
+
+  self->latency = latency;
+  self->number_of_channels = number_of_channels;
+  self->channels =
+      (PipelineChannel *)calloc(number_of_channels, sizeof(PipelineChannel));
+  if (!self->channels) {
+    signal_pipeline_free(self);
+    return NULL;
+  }
+
+  const uint32_t capacity = latency + 2U * SIGNAL_PIPELINE_MAX_BLOCK;
+  for (uint32_t c = 0U; c < number_of_channels; c++) {
+    PipelineChannel *channel = &self->channels[c];
+    channel->input = spsc_ring_initialize(capacity, sizeof(float));
+    channel->output = spsc_ring_initialize(capacity, sizeof(float));
+    if (!channel->input || !channel->output) {
+      signal_pipeline_free(self);
+      return NULL;
+    }
+
+    for (uint32_t k = 0U; k < latency; k += SIGNAL_PIPELINE_CHUNK) {
+      const uint32_t chunk = latency - k < SIGNAL_PIPELINE_CHUNK
+                                 ? latency - k
+                                 : SIGNAL_PIPELINE_CHUNK;
+      spsc_ring_write(channel->output, channel->output_chunk, chunk);
+    }
+  }
+
+  return self;
+}
+
+void signal_pipeline_free(SignalPipeline *self) {
+  for (uint32_t c = 0U; self->channels && c < self->number_of_channels; c++) {
+    if (self->channels[c].input) {
+      spsc_ring_free(self->channels[c].input);
+    }
+    if (self->channels[c].output) {
+      spsc_ring_free(self->channels[c].output);
+    }
+  }
+
+  free(self->channels);
+  free(self);
+}
+
+uint32_t signal_pipeline_get_latency(const SignalPipeline *self) {
+  return self->latency;
+}
+
+bool signal_pipeline_push(SignalPipeline *self,
+                          const uint32_t number_of_samples,
+                          const float *const *inputs) {
+  if (number_of_samples > SIGNAL_PIPELINE_MAX_BLOCK) {
+    return false;
+  }
+
+  bool pushed = true;
+  for (uint32_t c = 0U; c < self->number_of_channels; c++) {
+    pushed &= spsc_ring_write(self->channels[c].input, inputs[c],
+                              number_of_samples) == number_of_samples;
+  }
+
+  return pushed;
+}
+
+// Nothing is taken unless every channel can give the whole block
+bool signal_pipeline_pull(SignalPipeline *self,
+                          const uint32_t number_of_samples,
+                          float *const *outputs) {
+  for (uint32_t c = 0U; c < self->number_of_channels; c++) {
+    if (spsc_ring_get_count(self->channels[c].output) < number_of_samples) {
+      return false;
+    }
+  }
+
+  for (uint32_t c = 0U; c < self->number_of_channels; c++) {
+    spsc_ring_read(self->channels[c].output, outputs[c], number_of_samples);
+  }
+
+  return true;
+}
+
+uint32_t signal_pipeline_prepare(SignalPipeline *self, const float **inputs,
+                                 float **outputs) {
+  uint32_t number_of_samples = SIGNAL_PIPELINE_CHUNK;
+  for (uint32_t c = 0U; c < self->number_of_channels; c++) {
+    const uint32_t pending = spsc_ring_get_count(self->channels[c].input);
+    number_of_samples =
+        pending < number_of_samples ? pending : number_of_samples;
+  }
+
+  for (uint32_t c = 0U; c < self->number_of_channels; c++) {
+    PipelineChannel *channel = &self->channels[c];
+    spsc_ring_read(channel->input, channel->input_chunk, number_of_samples);
+    inputs[c] = channel->input_chunk;
+    outputs[c] = channel->output_chunk;
+  }
+
+  return number_of_samples;
+}
+
+void signal_pipeline_commit(SignalPipeline *self,
+                            const uint32_t number_of_samples) {
+  for (uint32_t c = 0U; c < self->number_of_channels; c++) {
+    spsc_ring_write(self->channels[c].output, self->channels[c].output_chunk,
+                    number_of_samples);
+  }
+}
@@ -0,0 +1,55 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef SIGNAL_PIPELINE_H
+#define SIGNAL_PIPELINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Largest block accepted by signal_pipeline_push and signal_pipeline_pull
+#define SIGNAL_PIPELINE_MAX_BLOCK 4096U
+#define SIGNAL_PIPELINE_MAX_LATENCY 8192U
+// Largest block handed out by signal_pipeline_prepare
+#define SIGNAL_PIPELINE_CHUNK 256U
+
+/*
+ * Moves the processing of a multichannel stream to another thread. The
+ * audio thread pushes its input and pulls output that was finished while
+ * it was away, the other thread takes the pending input in chunks and
+ * commits what it made of it. The output starts with latency samples of
+ * silence, so as long as host blocks are no longer than that the worker
+ * has a whole period to catch up.
+ */
+typedef struct SignalPipeline SignalPipeline;
+
+SignalPipeline *signal_pipeline_initialize(uint32_t number_of_channels,
+                                           uint32_t latency);
+void signal_pipeline_free(SignalPipeline *self);
+uint32_t signal_pipeline_get_latency(const SignalPipeline *self);
+bool signal_pipeline_push(SignalPipeline *self, uint32_t number_of_samples,
+                          const float *const *inputs);
+bool signal_pipeline_pull(SignalPipeline *self, uint32_t number_of_samples,
+                          float *const *outputs);
+uint32_t signal_pipeline_prepare(SignalPipeline *self, const float **inputs,
+                                 float **outputs);
+void signal_pipeline_commit(SignalPipeline *self, uint32_t number_of_samples);
+
+#endif
@@ -0,0 +1,57 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "simd_kernels.h"
+#include <stddef.h>
+
+extern const SimdKernels simd_kernels_generic;
+
+#if defined(NREPELLENT_X86_DISPATCH)
+extern const SimdKernels simd_kernels_avx2;
+extern const SimdKernels simd_kernels_avx512;
+#endif
+
+static const SimdKernels *simd_kernels_select(void) {
+#if defined(NREPELLENT_X86_DISPATCH)
+  // Also checks that the OS saves the wider registers
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx512f")) {
+    return &simd_kernels_avx512;
+  }
+
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return &simd_kernels_avx2;
+  }
+#endif
+
+  return &simd_kernels_generic;
+}
+
+const SimdKernels *simd_kernels_get(void) {
+  // Every caller selects the same table, so a racing first call is harmless
+  static const SimdKernels *selected = NULL;
+
+  if (!selected) {
+    selected = simd_kernels_select();
+  }
+
+  return selected;
+}
@@ -0,0 +1,45 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+#include <stdint.h>
+
+/*
+ * Hot loops compiled once per instruction set and picked at runtime from
+ * the cpu features, so the shipped binary doesn't stay on the baseline.
+ */
+typedef struct SimdKernels {
+  const char *name;
+  float (*sum_of_squares)(const float *input, uint32_t number_of_samples);
+  void (*apply_gain)(const float *input, float gain, float *output,
+                     uint32_t number_of_samples);
+  float (*crossfade)(const float *dry, float *output, float target,
+                     float distance, float decay, uint32_t number_of_samples);
+  void (*deinterleave)(const float *input, uint32_t channels,
+                       float *const *output, uint32_t number_of_frames);
+  void (*interleave)(const float *const *input, uint32_t channels,
+                     float *output, uint32_t number_of_frames);
+} SimdKernels;
+
+const SimdKernels *simd_kernels_get(void);
+
+#endif
@@ -0,0 +1,32 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+// Compiled with the baseline flags of the build, SSE2 on x86 targets
+#include "simd_kernels_template.h"
+
+#if defined(__SSE2__)
+#define SIMD_KERNELS_BASELINE_NAME "SSE2"
+#else
+#define SIMD_KERNELS_BASELINE_NAME "Generic"
+#endif
+
+extern const SimdKernels simd_kernels_generic;
+const SimdKernels simd_kernels_generic =
+    SIMD_KERNELS_TABLE(SIMD_KERNELS_BASELINE_NAME);
@@ -0,0 +1,133 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+// Kernel bodies shared by every simd_kernels_<isa>.c. Each one includes this
+// file once and is compiled with its own target flags, so the loops below
+// are written to be auto-vectorized rather than with intrinsics.
+
+#include "simd_kernels.h"
+#include <stddef.h>
+
+static float kernel_sum_of_squares(const float *input,
+                                   const uint32_t number_of_samples) {
+  float sum = 0.F;
+  for (uint32_t k = 0U; k < number_of_samples; k++) {
+    sum += input[k] * input[k];
+  }
+  return sum;
+}
+
+static void kernel_apply_gain(const float *input, const float gain,
+                              float *output,
+                              const uint32_t number_of_samples) {
+  for (uint32_t k = 0U; k < number_of_samples; k++) {
+    output[k] = input[k] * gain;
+  }
+}
+
+#define RAMP_LANES 16U
+
+// Exponential ramp of the wet gain towards target, one value per sample.
+// The gain of lane j is target - distance * decay^(j + 1), so every group of
+// lanes is independent and only the distance is carried between groups.
+static float kernel_crossfade(const float *dry, float *output,
+                              const float target, float distance,
+                              const float decay,
+                              const uint32_t number_of_samples) {
+  float lane_decay[RAMP_LANES];
+  lane_decay[0] = decay;
+  for (uint32_t j = 1U; j < RAMP_LANES; j++) {
+    lane_decay[j] = lane_decay[j - 1U] * decay;
+  }
+
+  uint32_t k = 0U;
+  for (; k + RAMP_LANES <= number_of_samples; k += RAMP_LANES) {
+    for (uint32_t j = 0U; j < RAMP_LANES; j++) {
+      const float wet_gain = target - distance * lane_decay[j];
+      output[k + j] = dry[k + j] + wet_gain * (output[k + j] - dry[k + j]);
+    }
+    distance *= lane_decay[RAMP_LANES - 1U];
+  }
+
+  const uint32_t remaining = number_of_samples - k;
+  for (uint32_t j = 0U; j < remaining; j++) {
+    const float wet_gain = target - distance * lane_decay[j];
+    output[k + j] = dry[k + j] + wet_gain * (output[k + j] - dry[k + j]);
+  }
+
+  return remaining > 0U ? distance * lane_decay[remaining - 1U] : distance;
+}
+
+// Stereo gets its own loops so the stride is a constant the compiler can
+// turn into shuffles. Indexes are size_t, unsigned 32 bit ones may wrap and
+// that keeps strided accesses from vectorizing.
+static void kernel_deinterleave(const float *input, const uint32_t channels,
+                                float *const *output,
+                                const uint32_t number_of_frames) {
+  if (channels == 2U) {
+    float *left = output[0];
+    float *right = output[1];
+    for (size_t k = 0U; k < number_of_frames; k++) {
+      left[k] = input[2U * k];
+      right[k] = input[2U * k + 1U];
+    }
+    return;
+  }
+
+  for (uint32_t c = 0U; c < channels; c++) {
+    float *channel = output[c];
+    for (size_t k = 0U; k < number_of_frames; k++) {
+      channel[k] = input[k * channels + c];
+    }
+  }
+}
+
+static void kernel_interleave(const float *const *input,
+                              const uint32_t channels, float *output,
+                              const uint32_t number_of_frames) {
+  if (channels == 2U) {
+    const float *left = input[0];
+    const float *right = input[1];
+    for (size_t k = 0U; k < number_of_frames; k++) {
+      output[2U * k] = left[k];
+      output[2U * k + 1U] = right[k];
+    }
+    return;
+  }
+
+  for (uint32_t c = 0U; c < channels; c++) {
+    const float *channel = input[c];
+    for (size_t k = 0U; k < number_of_frames; k++) {
+      output[k * channels + c] = channel[k];
+    }
+  }
+}
+
+// clang-format off
+#define SIMD_KERNELS_TABLE(isa_name)                                           \
+  {                                                                            \
+    isa_name,                                                                  \
+    kernel_sum_of_squares,                                                     \
+    kernel_apply_gain,                                                         \
+    kernel_crossfade,                                                          \
+    kernel_deinterleave,                                                       \
+    kernel_interleave                                                          \
+  }
+// clang-format on
@@ -0,0 +1,145 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "spsc_ring.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_LINE 64U
+
+// Each index is written by one side only. They sit on their own cache lines
+// so the producer and the consumer don't invalidate each other.
+struct SpscRing {
+  uint32_t head; // Next element to pop, written by the consumer
+  char head_padding[CACHE_LINE - sizeof(uint32_t)];
+  uint32_t tail; // Next element to push, written by the producer
+  char tail_padding[CACHE_LINE - sizeof(uint32_t)];
+
+  uint32_t mask;
+  uint32_t element_size;
+  unsigned char *elements;
+};
+
+SpscRing *spsc_ring_initialize(const uint32_t capacity,
+                               const uint32_t element_size) {
+  SpscRing *self = (SpscRing *)calloc(1U, sizeof(SpscRing));
+  if (!self) {
+    return NULL;
+  }
+
+  // One slot stays empty to tell a full ring from an empty one, and the
+  // size is a power of two so indexes wrap with a mask
+  uint32_t size = 2U;
+  while (size < capacity + 1U) {
+    size *= 2U;
+  }
+
+  self->mask = size - 1U;
+  self->element_size = element_size;
+  self->elements = (unsigned char *)calloc(size, element_size);
+
+  if (!self->elements) {
+    spsc_ring_free(self);
+    return NULL;
+  }
+
+  return self;
+}
+
+void spsc_ring_free(SpscRing *self) {
+  free(self->elements);
+  free(self);
+}
+
+bool spsc_ring_push(SpscRing *self, const void *element) {
+  const uint32_t tail = __atomic_load_n(&self->tail, __ATOMIC_RELAXED);
+  const uint32_t next = (tail + 1U) & self->mask;
+
+  if (next == __atomic_load_n(&self->head, __ATOMIC_ACQUIRE)) {
+    return false;
+  }
+
+  memcpy(&self->elements[(size_t)tail * self->element_size], element,
+         self->element_size);
+  __atomic_store_n(&self->tail, next, __ATOMIC_RELEASE);
+
+  return true;
+}
+
+bool spsc_ring_pop(SpscRing *self, void *element) {
+  const uint32_t head = __atomic_load_n(&self->head, __ATOMIC_RELAXED);
+
+  if (head == __atomic_load_n(&self->tail, __ATOMIC_ACQUIRE)) {
+    return false;
+  }
+
+  memcpy(element, &self->elements[(size_t)head * self->element_size],
+         self->element_size);
+  __atomic_store_n(&self->head, (head + 1U) & self->mask, __ATOMIC_RELEASE);
+
+  return true;
+}
+
+// Bulk versions for streams of samples. They move as many elements as fit
+// or are available, in at most two copies around the wrap.
+uint32_t spsc_ring_write(SpscRing *self, const void *elements,
+                         const uint32_t count) {
+  const uint32_t tail = __atomic_load_n(&self->tail, __ATOMIC_RELAXED);
+  const uint32_t head = __atomic_load_n(&self->head, __ATOMIC_ACQUIRE);
+  const uint32_t space = (head - tail - 1U) & self->mask;
+  const uint32_t written = count < space ? count : space;
+
+  const uint32_t first = written < self->mask + 1U - tail
+                             ? written
+                             : self->mask + 1U - tail;
+  memcpy(&self->elements[(size_t)tail * self->element_size], elements,
+         (size_t)first * self->element_size);
+  memcpy(self->elements,
+         (const unsigned char *)elements + (size_t)first * self->element_size,
+         (size_t)(written - first) * self->element_size);
+  __atomic_store_n(&self->tail, (tail + written) & self->mask,
+                   __ATOMIC_RELEASE);
+
+  return written;
+}
+
+uint32_t spsc_ring_read(SpscRing *self, void *elements, const uint32_t count) {
+  const uint32_t head = __atomic_load_n(&self->head, __ATOMIC_RELAXED);
+  const uint32_t tail = __atomic_load_n(&self->tail, __ATOMIC_ACQUIRE);
+  const uint32_t available = (tail - head) & self->mask;
+  const uint32_t read = count < available ? count : available;
+
+  const uint32_t first =
+      read < self->mask + 1U - head ? read : self->mask + 1U - head;
+  memcpy(elements, &self->elements[(size_t)head * self->element_size],
+         (size_t)first * self->element_size);
+  memcpy((unsigned char *)elements + (size_t)first * self->element_size,
+         self->elements, (size_t)(read - first) * self->element_size);
+  __atomic_store_n(&self->head, (head + read) & self->mask, __ATOMIC_RELEASE);
+
+  return read;
+}
+
+uint32_t spsc_ring_get_count(const SpscRing *self) {
+  const uint32_t head = __atomic_load_n(&self->head, __ATOMIC_ACQUIRE);
+  const uint32_t tail = __atomic_load_n(&self->tail, __ATOMIC_ACQUIRE);
+
+  return (tail - head) & self->mask;
+}
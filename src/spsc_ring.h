@@ -0,0 +1,43 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Lock free ring of fixed size elements for exactly one producer thread and
+ * one consumer thread. Push and pop never block nor allocate, so either end
+ * may be a realtime thread.
+ */
+typedef struct SpscRing SpscRing;
+
+SpscRing *spsc_ring_initialize(uint32_t capacity, uint32_t element_size);
+void spsc_ring_free(SpscRing *self);
+bool spsc_ring_push(SpscRing *self, const void *element);
+bool spsc_ring_pop(SpscRing *self, void *element);
+uint32_t spsc_ring_write(SpscRing *self, const void *elements,
+                         uint32_t count);
+uint32_t spsc_ring_read(SpscRing *self, void *elements, uint32_t count);
+uint32_t spsc_ring_get_count(const SpscRing *self);
+
+#endif
@@ -0,0 +1,514 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _GNU_SOURCE
+
+#include "thread_pool.h"
+#include <dlfcn.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define THREAD_POOL_ABI 2U // Bumped whenever ThreadPool changes layout
+#define SHARE_SYMBOL "nrepellent_thread_pool_share"
+#define MAXIMUM_WORKERS 64U
+#define DEFAULT_MAXIMUM_WORKERS 8U
+#define QUEUE_CAPACITY 256U // Power of two
+#define CACHE_LINE 64U
+#define SPINS_BEFORE_SLEEP 1024U
+#define SLEEP_NANOSECONDS 20000L
+#define MAXIMUM_PATH 4096U
+
+#ifdef __APPLE__
+#define MODULE_EXTENSION ".dylib"
+#else
+#define MODULE_EXTENSION ".so"
+#endif
+
+enum { TASK_IDLE = 0, TASK_QUEUED = 1, TASK_DONE = 2 };
+
+// The sequence tells whose turn the cell is: a producer's when it equals the
+// position, a consumer's one past it.
+typedef struct ThreadPoolCell {
+  uint32_t sequence;
+  ThreadPoolTask *task;
+} ThreadPoolCell;
+
+// Bounded lock-free queue, many producers and many consumers. Whoever swaps
+// the task out of its cell runs it, the worker that dequeued the cell or the
+// submitter taking it back, so no entry outlives its task. A thread stopped
+// halfway only makes the others see the queue as full or empty, nobody
+// waits on it.
+typedef struct ThreadPoolQueue {
+  uint32_t enqueue_position;
+  char enqueue_padding[CACHE_LINE - sizeof(uint32_t)];
+  uint32_t dequeue_position;
+  char dequeue_padding[CACHE_LINE - sizeof(uint32_t)];
+  ThreadPoolCell cells[QUEUE_CAPACITY];
+} ThreadPoolQueue;
+
+typedef struct ThreadPoolWorker {
+  ThreadPool *pool;
+  uint32_t index;
+  pthread_t thread;
+} ThreadPoolWorker;
+
+struct ThreadPool {
+  uint32_t abi;
+  void (*unshare)(ThreadPool *self); // Release of the owning binary
+
+  uint32_t number_of_workers;
+  uint32_t number_of_threads; // Started so far, joined when stopping
+  uint32_t next_queue;
+  int running;
+  sem_t wakeup;
+
+  ThreadPoolWorker workers[MAXIMUM_WORKERS];
+  ThreadPoolQueue queues[MAXIMUM_WORKERS];
+};
+
+// Pool created by this binary, or borrowed from a sibling one
+static pthread_mutex_t shared_lock = PTHREAD_MUTEX_INITIALIZER;
+static ThreadPool *shared_pool = NULL;
+static uint32_t shared_references = 0U;
+static void *sibling_module = NULL;
+static uint32_t sibling_references = 0U;
+
+static void relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+static void queue_initialize(ThreadPoolQueue *self) {
+  for (uint32_t i = 0U; i < QUEUE_CAPACITY; i++) {
+    self->cells[i].sequence = i;
+  }
+}
+
+static bool queue_push(ThreadPoolQueue *self, ThreadPoolTask *task) {
+  ThreadPoolCell *cell = NULL;
+  uint32_t position =
+      __atomic_load_n(&self->enqueue_position, __ATOMIC_RELAXED);
+
+  for (;;) {
+    cell = &self->cells[position & (QUEUE_CAPACITY - 1U)];
+    const int32_t difference =
+        (int32_t)(__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) -
+                  position);
+
+    if (difference == 0) {
+      if (__atomic_compare_exchange_n(&self->enqueue_position, &position,
+                                      position + 1U, true, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (difference < 0) {
+      return false;
+    } else {
+      position = __atomic_load_n(&self->enqueue_position, __ATOMIC_RELAXED);
+    }
+  }
+
+  task->cell = &cell->task;
+  __atomic_store_n(&cell->task, task, __ATOMIC_RELAXED);
+  __atomic_store_n(&cell->sequence, position + 1U, __ATOMIC_RELEASE);
+  return true;
+}
+
+// False once the queue is empty. The task is NULL when its submitter took it
+// back first, the cell is recycled all the same.
+static bool queue_pop(ThreadPoolQueue *self, ThreadPoolTask **task) {
+  ThreadPoolCell *cell = NULL;
+  uint32_t position =
+      __atomic_load_n(&self->dequeue_position, __ATOMIC_RELAXED);
+
+  for (;;) {
+    cell = &self->cells[position & (QUEUE_CAPACITY - 1U)];
+    const int32_t difference =
+        (int32_t)(__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) -
+                  (position + 1U));
+
+    if (difference == 0) {
+      if (__atomic_compare_exchange_n(&self->dequeue_position, &position,
+                                      position + 1U, true, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (difference < 0) {
+      return false;
+    } else {
+      position = __atomic_load_n(&self->dequeue_position, __ATOMIC_RELAXED);
+    }
+  }
+
+  *task = __atomic_exchange_n(&cell->task, NULL, __ATOMIC_ACQUIRE);
+  __atomic_store_n(&cell->sequence, position + QUEUE_CAPACITY,
+                   __ATOMIC_RELEASE);
+  return true;
+}
+
+static ThreadPoolTask *queue_take(ThreadPoolQueue *self) {
+  ThreadPoolTask *task = NULL;
+  while (queue_pop(self, &task) && !task) {
+  }
+  return task;
+}
+
+static void run_task(ThreadPoolTask *task) {
+  task->function(task->context);
+  __atomic_store_n(&task->state, TASK_DONE, __ATOMIC_RELEASE);
+}
+
+static void *work(void *data) {
+  ThreadPoolWorker *worker = (ThreadPoolWorker *)data;
+  ThreadPool *pool = worker->pool;
+
+  while (__atomic_load_n(&pool->running, __ATOMIC_ACQUIRE)) {
+    ThreadPoolTask *task = queue_take(&pool->queues[worker->index]);
+
+    for (uint32_t i = 1U; !task && i < pool->number_of_workers; i++) {
+      const uint32_t victim = (worker->index + i) % pool->number_of_workers;
+      task = queue_take(&pool->queues[victim]);
+    }
+
+    if (task) {
+      run_task(task);
+    } else {
+      while (sem_wait(&pool->wakeup) != 0 && errno == EINTR) {
+      }
+    }
+  }
+
+  return NULL;
+}
+
+static uint32_t get_environment_number(const char *name,
+                                       const uint32_t fallback) {
+  const char *value = getenv(name);
+  if (!value || *value == '\0') {
+    return fallback;
+  }
+
+  char *end = NULL;
+  const unsigned long number = strtoul(value, &end, 10);
+  return *end == '\0' ? (uint32_t)number : fallback;
+}
+
+// CPU lists as in taskset, e.g. "2-5,8"
+static bool parse_affinity(const char *list, cpu_set_t *cpus) {
+  CPU_ZERO(cpus);
+
+  const char *cursor = list;
+  while (*cursor != '\0') {
+    char *end = NULL;
+    const unsigned long first = strtoul(cursor, &end, 10);
+    if (end == cursor) {
+      return false;
+    }
+
+    unsigned long last = first;
+    if (*end == '-') {
+      cursor = end + 1;
+      last = strtoul(cursor, &end, 10);
+      if (end == cursor || last < first) {
+        return false;
+      }
+    }
+
+    for (unsigned long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+      CPU_SET((int)cpu, cpus);
+    }
+
+    cursor = *end == ',' ? end + 1 : end;
+    if (*end != ',' && *end != '\0') {
+      return false;
+    }
+  }
+
+  return CPU_COUNT(cpus) > 0;
+}
+
+static void thread_pool_destroy(ThreadPool *self) {
+  __atomic_store_n(&self->running, 0, __ATOMIC_RELEASE);
+
+  for (uint32_t i = 0U; i < self->number_of_threads; i++) {
+    sem_post(&self->wakeup);
+  }
+  for (uint32_t i = 0U; i < self->number_of_threads; i++) {
+    pthread_join(self->workers[i].thread, NULL);
+  }
+
+  sem_destroy(&self->wakeup);
+  free(self);
+}
+
+static void unshare_pool(ThreadPool *self) {
+  pthread_mutex_lock(&shared_lock);
+
+  if (self == shared_pool && --shared_references == 0U) {
+    thread_pool_destroy(shared_pool);
+    shared_pool = NULL;
+  }
+
+  pthread_mutex_unlock(&shared_lock);
+}
+
+static ThreadPool *thread_pool_create(void) {
+  const long online = sysconf(_SC_NPROCESSORS_ONLN);
+  uint32_t fallback = online > 1L ? (uint32_t)(online - 1L) : 0U;
+  if (fallback > DEFAULT_MAXIMUM_WORKERS) {
+    fallback = DEFAULT_MAXIMUM_WORKERS;
+  }
+
+  uint32_t number_of_workers =
+      get_environment_number("NREPELLENT_THREADS", fallback);
+  if (number_of_workers == 0U) {
+    return NULL;
+  }
+  if (number_of_workers > MAXIMUM_WORKERS) {
+    number_of_workers = MAXIMUM_WORKERS;
+  }
+
+  ThreadPool *self = (ThreadPool *)calloc(1U, sizeof(ThreadPool));
+  if (!self) {
+    return NULL;
+  }
+
+  if (sem_init(&self->wakeup, 0, 0U) != 0) {
+    free(self);
+    return NULL;
+  }
+
+  self->abi = THREAD_POOL_ABI;
+  self->unshare = unshare_pool;
+  self->running = 1;
+  for (uint32_t i = 0U; i < MAXIMUM_WORKERS; i++) {
+    queue_initialize(&self->queues[i]);
+  }
+
+  const char *affinity = getenv("NREPELLENT_THREAD_AFFINITY");
+  cpu_set_t cpus;
+  const bool pinned = affinity && parse_affinity(affinity, &cpus);
+
+  // Realtime workers are opt-in, they could starve a host that isn't
+  const int priority =
+      (int)get_environment_number("NREPELLENT_THREAD_PRIORITY", 0U);
+
+  // Workers read the count right away, it can't grow as they start
+  self->number_of_workers = number_of_workers;
+  for (uint32_t i = 0U; i < number_of_workers; i++) {
+    ThreadPoolWorker *worker = &self->workers[i];
+    worker->pool = self;
+    worker->index = i;
+
+    if (pthread_create(&worker->thread, NULL, work, worker) != 0) {
+      thread_pool_destroy(self);
+      return NULL;
+    }
+    self->number_of_threads++;
+
+    if (pinned) {
+      pthread_setaffinity_np(worker->thread, sizeof(cpu_set_t), &cpus);
+    }
+
+    // Without the privilege the workers keep normal scheduling
+    if (priority > 0) {
+      struct sched_param parameters;
+      memset(&parameters, 0, sizeof(struct sched_param));
+      parameters.sched_priority = priority;
+      pthread_setschedparam(worker->thread, SCHED_FIFO, &parameters);
+    }
+  }
+
+  return self;
+}
+
+// Called directly within this binary, so a same named symbol of another
+// one can never stand in for it
+static ThreadPool *share_pool(const uint32_t abi, const bool create) {
+  if (abi != THREAD_POOL_ABI) {
+    return NULL;
+  }
+
+  pthread_mutex_lock(&shared_lock);
+
+  if (!shared_pool && create) {
+    shared_pool = thread_pool_create();
+  }
+  if (shared_pool) {
+    shared_references++;
+  }
+  ThreadPool *pool = shared_pool;
+
+  pthread_mutex_unlock(&shared_lock);
+
+  return pool;
+}
+
+// Looked up by the other binaries of the bundle, so it is the one symbol of
+// the pool left visible
+__attribute__((visibility("default"))) ThreadPool *
+nrepellent_thread_pool_share(const uint32_t abi, const bool create) {
+  return share_pool(abi, create);
+}
+
+static ThreadPool *borrow_from_sibling(const char *bundle_path,
+                                       const char *sibling) {
+  char path[MAXIMUM_PATH];
+  const size_t length = strlen(bundle_path);
+  const int written =
+      snprintf(path, sizeof(path), "%s%s%s" MODULE_EXTENSION, bundle_path,
+               length > 0U && bundle_path[length - 1U] == '/' ? "" : "/",
+               sibling);
+  if (written < 0 || (size_t)written >= sizeof(path)) {
+    return NULL;
+  }
+
+  // Only a sibling the host already loaded, never a new one
+  void *module = dlopen(path, RTLD_LAZY | RTLD_NOLOAD);
+  if (!module) {
+    return NULL;
+  }
+
+  ThreadPool *(*share)(uint32_t, bool) = NULL;
+  *(void **)&share = dlsym(module, SHARE_SYMBOL);
+
+  ThreadPool *pool = share ? share(THREAD_POOL_ABI, false) : NULL;
+
+  // The lookup can resolve to this very binary, its pool is taken directly
+  if (pool && pool->unshare == unshare_pool) {
+    unshare_pool(pool);
+    pool = NULL;
+  }
+  if (!pool) {
+    dlclose(module);
+    return NULL;
+  }
+
+  // The sibling stays loaded while its pool is in use here
+  pthread_mutex_lock(&shared_lock);
+  if (sibling_module) {
+    dlclose(module);
+  } else {
+    sibling_module = module;
+  }
+  sibling_references++;
+  pthread_mutex_unlock(&shared_lock);
+
+  return pool;
+}
+
+// Not realtime safe, call it when instantiating. Returns NULL when the pool
+// is turned off or can't start, tasks then run on the submitting thread.
+ThreadPool *thread_pool_acquire(const char *bundle_path,
+                                const char *const *siblings) {
+  ThreadPool *pool = share_pool(THREAD_POOL_ABI, false);
+
+  for (uint32_t i = 0U;
+       !pool && bundle_path && *bundle_path != '\0' && siblings && siblings[i];
+       i++) {
+    pool = borrow_from_sibling(bundle_path, siblings[i]);
+  }
+
+  return pool ? pool : share_pool(THREAD_POOL_ABI, true);
+}
+
+// Not realtime safe. Tasks of the caller must be waited for first.
+void thread_pool_release(ThreadPool *self) {
+  if (self->unshare == unshare_pool) {
+    unshare_pool(self);
+    return;
+  }
+
+  self->unshare(self);
+
+  pthread_mutex_lock(&shared_lock);
+  if (--sibling_references == 0U) {
+    dlclose(sibling_module);
+    sibling_module = NULL;
+  }
+  pthread_mutex_unlock(&shared_lock);
+}
+
+void thread_pool_task_initialize(ThreadPoolTask *task,
+                                 const ThreadPoolFunction function,
+                                 void *context) {
+  task->function = function;
+  task->context = context;
+  task->cell = NULL;
+  task->state = TASK_IDLE;
+}
+
+// Returns false when the task stays with the caller, thread_pool_wait then
+// runs it. Either way thread_pool_wait must follow.
+bool thread_pool_submit(ThreadPool *self, ThreadPoolTask *task) {
+  task->cell = NULL;
+  __atomic_store_n(&task->state, TASK_QUEUED, __ATOMIC_RELAXED);
+
+  if (!self) {
+    return false;
+  }
+
+  const uint32_t first =
+      __atomic_fetch_add(&self->next_queue, 1U, __ATOMIC_RELAXED);
+  for (uint32_t i = 0U; i < self->number_of_workers; i++) {
+    if (queue_push(&self->queues[(first + i) % self->number_of_workers],
+                   task)) {
+      sem_post(&self->wakeup);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Spins only on a task a worker already started, never on a queue
+void thread_pool_wait(ThreadPool *self, ThreadPoolTask *task) {
+  (void)self;
+
+  ThreadPoolTask *expected = task;
+  if (!task->cell ||
+      __atomic_compare_exchange_n(task->cell, &expected, NULL, false,
+                                  __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+    task->cell = NULL;
+    run_task(task);
+    return;
+  }
+
+  for (uint32_t spins = 0U;
+       __atomic_load_n(&task->state, __ATOMIC_ACQUIRE) != TASK_DONE;
+       spins++) {
+    // sched_yield never hands the core to a lower priority worker
+    if (spins < SPINS_BEFORE_SLEEP) {
+      relax();
+    } else {
+      const struct timespec pause = {0, SLEEP_NANOSECONDS};
+      nanosleep(&pause, NULL);
+    }
+  }
+  task->cell = NULL;
+}
@@ -0,0 +1,64 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Worker threads shared by every instance in the process, so hundreds of
+ * instances splitting their channels don't oversubscribe the cores. The pool
+ * is created by the first instance that asks for it and stopped when the last
+ * one lets it go. Plugin binaries of the same bundle
+ * look each other up, so they share one pool too.
+ *
+ * Every worker owns a lock-free queue of tasks and steals from the others
+ * once its own is empty. Submitting and waiting never take a lock nor
+ * allocate: a task no worker has started yet is taken back and run by the
+ * waiting thread itself, and a full queue leaves the task to it as well.
+ *
+ * Size, CPU affinity and priority come from NREPELLENT_THREADS (0 turns the
+ * pool off), NREPELLENT_THREAD_AFFINITY (e.g. "2-5,8") and
+ * NREPELLENT_THREAD_PRIORITY (SCHED_FIFO when set, normal scheduling by
+ * default).
+ */
+typedef struct ThreadPool ThreadPool;
+
+typedef void (*ThreadPoolFunction)(void *context);
+
+// Owned by the caller, one submission at a time
+typedef struct ThreadPoolTask {
+  ThreadPoolFunction function;
+  void *context;
+  struct ThreadPoolTask **cell; // Queue entry while submitted
+  int state;
+} ThreadPoolTask;
+
+ThreadPool *thread_pool_acquire(const char *bundle_path,
+                                const char *const *siblings);
+void thread_pool_release(ThreadPool *self);
+void thread_pool_task_initialize(ThreadPoolTask *task,
+                                 ThreadPoolFunction function, void *context);
+bool thread_pool_submit(ThreadPool *self, ThreadPoolTask *task);
+void thread_pool_wait(ThreadPool *self, ThreadPoolTask *task);
+
+#endif
@@ -0,0 +1,44 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef USDT_PROBES_H
+#define USDT_PROBES_H
+
+/*
+ * Static tracepoints of the nrepellent provider, for perf, bpftrace or
+ * SystemTap attached to a live host, e.g.
+ *
+ *   bpftrace -e 'usdt:nrepellent.so:nrepellent:run_end { @ = count(); }'
+ *
+ * Built with NREPELLENT_USDT each one is a nop until a tracer attaches,
+ * without it they are gone and their arguments never evaluated.
+ */
+#ifdef NREPELLENT_USDT
+#include <sys/sdt.h>
+#define USDT_PROBE1(name, a) DTRACE_PROBE1(nrepellent, name, a)
+#define USDT_PROBE2(name, a, b) DTRACE_PROBE2(nrepellent, name, a, b)
+#define USDT_PROBE3(name, a, b, c) DTRACE_PROBE3(nrepellent, name, a, b, c)
+#else
+#define USDT_PROBE1(name, a) ((void)0)
+#define USDT_PROBE2(name, a, b) ((void)0)
+#define USDT_PROBE3(name, a, b, c) ((void)0)
+#endif
+
+#endif
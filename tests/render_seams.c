@@ -0,0 +1,190 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+// Renders a generated signal serially and in segments with nrepellent-render
+// and fails when the stitched render strays from the serial one by more
+// than the bound anywhere, which would be at a seam. The manual plugin
+// restores the same profile in every segment, so both renders match. The
+// adaptive one converges during the warmup instead, its segments may differ
+// by up to the noise level but a seam would click at the level of the tone.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define SAMPLE_RATE 48000U
+#define SECONDS 24U
+#define SEGMENTS "4"
+#define SEAM_BOUND -60.F          // dBFS
+#define ADAPTIVE_SEAM_BOUND -30.F // dBFS, the noise is at -40 dBFS
+#define MAXIMUM_PATH 4096
+#define TWO_PI 6.28318530718F
+
+static bool write_signal(const char *path) {
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    return false;
+  }
+
+  // A tone over white noise, the first two seconds noise only to learn it
+  uint32_t seed = 1U;
+  bool written = true;
+  for (uint32_t k = 0U; written && k < SAMPLE_RATE * SECONDS; k++) {
+    seed = seed * 1664525U + 1013904223U;
+    const float noise = ((float)(seed >> 8U) / 16777216.F - 0.5F) * 0.02F;
+    const float tone =
+        k < 2U * SAMPLE_RATE
+            ? 0.F
+            : 0.25F * sinf(TWO_PI * 440.F * (float)k /
+                           (float)SAMPLE_RATE);
+    const float sample = tone + noise;
+    written = fwrite(&sample, sizeof(float), 1U, file) == 1U;
+  }
+
+  return fclose(file) == 0 && written;
+}
+
+static bool render(const char *renderer, const char *input,
+                   const char *output, const char *segments,
+                   const bool adaptive) {
+  const pid_t pid = fork();
+  if (pid == 0) {
+    if (adaptive) {
+      execl(renderer, renderer, "--raw-f32", "48000:1", "-p", "adaptive",
+            "--warmup", "5", "--segments", segments, "-o", output, input,
+            (char *)NULL);
+    } else {
+      execl(renderer, renderer, "--raw-f32", "48000:1", "--learn", "0:2",
+            "--segments", segments, "-o", output, input, (char *)NULL);
+    }
+    _exit(127);
+  }
+
+  int status = 0;
+  return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+         WEXITSTATUS(status) == 0;
+}
+
+static float *read_samples(const char *path, size_t *number_of_samples) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    return NULL;
+  }
+
+  float *samples = (float *)calloc(SAMPLE_RATE * SECONDS, sizeof(float));
+  if (samples) {
+    *number_of_samples =
+        fread(samples, sizeof(float), SAMPLE_RATE * SECONDS, file);
+  }
+  fclose(file);
+
+  return samples;
+}
+
+static bool compare_renders(const char *renderer, const char *input,
+                            const char *serial, const char *stitched,
+                            const bool adaptive) {
+  const char *name = adaptive ? "adaptive" : "manual";
+  const float bound = adaptive ? ADAPTIVE_SEAM_BOUND : SEAM_BOUND;
+
+  size_t serial_samples = 0U;
+  size_t stitched_samples = 0U;
+  float *serial_render = NULL;
+  float *stitched_render = NULL;
+
+  bool passed = render(renderer, input, serial, "1", adaptive) &&
+                render(renderer, input, stitched, SEGMENTS, adaptive);
+  if (passed) {
+    serial_render = read_samples(serial, &serial_samples);
+    stitched_render = read_samples(stitched, &stitched_samples);
+    passed = serial_render && stitched_render &&
+             serial_samples == SAMPLE_RATE * SECONDS &&
+             stitched_samples == serial_samples;
+  }
+
+  if (passed) {
+    float maximum_error = 0.F;
+    size_t maximum_sample = 0U;
+    for (size_t i = 0U; i < serial_samples; i++) {
+      const float error = fabsf(stitched_render[i] - serial_render[i]);
+      if (error > maximum_error) {
+        maximum_error = error;
+        maximum_sample = i;
+      }
+    }
+
+    const float error = 20.F * log10f(fmaxf(maximum_error, 1e-12F));
+    passed = error <= bound;
+    printf("%s: seam error %.1f dBFS at sample %zu, bound %.1f dBFS\n", name,
+           error, maximum_sample, bound);
+  } else {
+    fprintf(stderr, "%s: rendering the signal failed\n", name);
+  }
+
+  free(serial_render);
+  free(stitched_render);
+  remove(serial);
+  remove(stitched);
+
+  return passed;
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s NREPELLENT_RENDER\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  const char *temporary = getenv("TMPDIR");
+  char directory[MAXIMUM_PATH - 32];
+  snprintf(directory, sizeof(directory), "%s/nrepellent-seamsXXXXXX",
+           temporary ? temporary : "/tmp");
+  if (!mkdtemp(directory)) {
+    perror("mkdtemp");
+    return EXIT_FAILURE;
+  }
+
+  char input[MAXIMUM_PATH];
+  char serial[MAXIMUM_PATH];
+  char stitched[MAXIMUM_PATH];
+  snprintf(input, sizeof(input), "%s/input.f32", directory);
+  snprintf(serial, sizeof(serial), "%s/serial.f32", directory);
+  snprintf(stitched, sizeof(stitched), "%s/stitched.f32", directory);
+
+  bool passed = write_signal(input);
+  if (!passed) {
+    fprintf(stderr, "Writing the signal failed\n");
+  }
+
+  passed = passed && compare_renders(argv[1], input, serial, stitched, false);
+  passed = passed && compare_renders(argv[1], input, serial, stitched, true);
+
+  remove(input);
+  rmdir(directory);
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
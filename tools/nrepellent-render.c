@@ -0,0 +1,1859 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "render_jobs.h"
+#include "render_pipeline.h"
+#include "render_plugin.h"
+#include "render_scan.h"
+#include "render_state.h"
+#include "../src/simd_kernels.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <sndfile.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BLOCK_FRAMES 4096U
+#define MAXIMUM_SETTINGS 32U
+#define MAXIMUM_SYMBOL 64U
+#define MAXIMUM_PATH 4096U
+#define DEFAULT_WARMUP_SECONDS 5.
+#define DEFAULT_SEAM_TOLERANCE -60.F // dBFS
+#define SCAN_WINDOW_SECONDS 0.5
+#define SCAN_SUBFRAME_SECONDS 0.01
+#define SCAN_WINDOWS_PER_JOB 120U // One minute of audio per scan job
+#define HALF_PI 1.57079632679F
+
+typedef enum RenderSampleFormat {
+  RENDER_PCM_F32 = 0,
+  RENDER_PCM_S16 = 1,
+  RENDER_PCM_S32 = 2,
+} RenderSampleFormat;
+
+typedef struct RenderSetting {
+  char symbol[MAXIMUM_SYMBOL];
+  float value;
+} RenderSetting;
+
+typedef struct RenderOptions {
+  RenderPluginType type;
+  RenderSetting settings[MAXIMUM_SETTINGS];
+  uint32_t number_of_settings;
+  const char *output;
+  const char *profile;
+  const char *save_profile;
+  bool learn;
+  double learn_start;
+  double learn_end;
+  float learn_mode;
+  double auto_learn;
+  uint32_t workers;
+  bool deterministic;
+  size_t memory_budget;
+  bool progress;
+  uint32_t segments;
+  double warmup;
+  bool verify_seams;
+  float seam_tolerance;
+  bool raw;
+  uint32_t raw_sample_rate;
+  uint32_t raw_channels;
+  bool stream;
+  RenderSampleFormat stream_format;
+  uint32_t stream_sample_rate;
+  uint32_t stream_channels;
+} RenderOptions;
+
+typedef struct RenderRange {
+  sf_count_t start;
+  sf_count_t end;
+} RenderRange;
+
+typedef struct RenderScanFile {
+  sf_count_t window_frames;
+  uint32_t number_of_windows;
+  float *scores;
+  RenderRange *ranges;
+  uint32_t number_of_ranges;
+} RenderScanFile;
+
+typedef struct RenderBatch {
+  const RenderOptions *options;
+  char *const *inputs;
+  const RenderState *profile;
+  RenderJobs *jobs;
+  const RenderScanFile *scan;
+} RenderBatch;
+
+typedef struct RenderSegments {
+  const RenderBatch *batch;
+  const char *input_path;
+  const RenderState *profile;
+  uint32_t number_of_segments;
+  sf_count_t total_frames;
+  sf_count_t warmup;
+  sf_count_t *boundaries;
+  FILE **parts;
+} RenderSegments;
+
+typedef struct RenderBuffers {
+  const SimdKernels *kernels;
+  uint32_t channels;
+  float *interleaved;
+  float **input;
+  float **output;
+  const float **cursor;
+} RenderBuffers;
+
+static void usage(FILE *stream) {
+  fprintf(stream,
+          "Usage: nrepellent-render [options] -o OUTPUT INPUT...\n"
+          "       nrepellent-render [options] --stream FORMAT:RATE:CHANNELS\n"
+          "\n"
+          "Renders audio files through noise-repellent without a host.\n"
+          "OUTPUT is a file for a single input or an existing directory.\n"
+          "\n"
+          "  -p, --plugin manual|adaptive  Plugin to use (default manual)\n"
+          "  -s, --set SYMBOL=VALUE        Set a control port by symbol\n"
+          "      --preset FILE             Read SYMBOL = VALUE lines\n"
+          "  -l, --learn START:END         Learn the noise profile from the\n"
+          "                                given seconds of every input\n"
+          "      --auto-learn SECONDS      Learn the noise profile from the\n"
+          "                                quietest SECONDS of every input\n"
+          "      --learn-mode average|median\n"
+          "      --profile FILE            Load a saved noise profile\n"
+          "      --save-profile FILE       Save the learned noise profile\n"
+          "  -o, --output PATH             Output file or directory\n"
+          "      --stream FORMAT:RATE:CHANNELS\n"
+          "                                Filter raw native PCM from stdin\n"
+          "                                to stdout, FORMAT is s16, s32 or\n"
+          "                                f32\n"
+          "      --raw-f32 RATE:CHANNELS   Inputs and outputs are raw native\n"
+          "                                float32 interleaved, mapped in\n"
+          "                                memory\n"
+          "  -j, --jobs N                  Files rendered at once (default\n"
+          "                                one per core)\n"
+          "      --memory MB               Memory budget shared by the jobs\n"
+          "      --deterministic           Fixed job order per worker, no\n"
+          "                                stealing\n"
+          "      --progress                Report progress and throughput\n"
+          "      --segments K              Split every file in K segments\n"
+          "                                rendered in parallel\n"
+          "      --warmup SECONDS          Audio rendered before each segment\n"
+          "                                and thrown away (default 5)\n"
+          "      --verify-seams            Compare segments with a serial\n"
+          "                                render, fail past the tolerance\n"
+          "      --seam-tolerance DBFS     Largest seam error accepted\n"
+          "                                (default -60)\n"
+          "  -h, --help                    Show this help\n");
+}
+
+static bool parse_float(const char *text, float *value) {
+  char *end = NULL;
+  *value = strtof(text, &end);
+  return end != text && *end == '\0';
+}
+
+static bool add_setting(RenderOptions *options, const char *symbol,
+                        const size_t symbol_length, const char *value) {
+  if (symbol_length == 0U || symbol_length >= MAXIMUM_SYMBOL) {
+    return false;
+  }
+
+  RenderSetting *setting = NULL;
+  for (uint32_t i = 0U; i < options->number_of_settings; i++) {
+    if (strlen(options->settings[i].symbol) == symbol_length &&
+        !strncmp(options->settings[i].symbol, symbol, symbol_length)) {
+      setting = &options->settings[i];
+    }
+  }
+
+  if (!setting) {
+    if (options->number_of_settings == MAXIMUM_SETTINGS) {
+      return false;
+    }
+    setting = &options->settings[options->number_of_settings++];
+  }
+
+  memcpy(setting->symbol, symbol, symbol_length);
+  setting->symbol[symbol_length] = '\0';
+
+  return parse_float(value, &setting->value);
+}
+
+static bool parse_setting(RenderOptions *options, const char *argument) {
+  const char *separator = strchr(argument, '=');
+  if (!separator) {
+    return false;
+  }
+
+  return add_setting(options, argument, (size_t)(separator - argument),
+                     separator + 1);
+}
+
+static char *trim(char *text) {
+  while (*text == ' ' || *text == '\t') {
+    text++;
+  }
+
+  size_t length = strlen(text);
+  while (length > 0U &&
+         strchr(" \t\r\n", text[length - 1U]) != NULL) {
+    text[--length] = '\0';
+  }
+
+  return text;
+}
+
+// Presets are plain "symbol = value" lines, '#' starts a comment
+static bool load_preset(RenderOptions *options, const char *path) {
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    fprintf(stderr, "Cannot open preset <%s>\n", path);
+    return false;
+  }
+
+  char line[256];
+  uint32_t line_number = 0U;
+  bool valid = true;
+
+  while (valid && fgets(line, sizeof(line), file)) {
+    line_number++;
+
+    char *comment = strchr(line, '#');
+    if (comment) {
+      *comment = '\0';
+    }
+
+    char *text = trim(line);
+    if (*text == '\0') {
+      continue;
+    }
+
+    char *separator = strchr(text, '=');
+    if (!separator) {
+      valid = false;
+      break;
+    }
+    *separator = '\0';
+
+    char *symbol = trim(text);
+    valid = add_setting(options, symbol, strlen(symbol), trim(separator + 1));
+  }
+
+  fclose(file);
+
+  if (!valid) {
+    fprintf(stderr, "Invalid preset line %u in <%s>\n", line_number, path);
+  }
+
+  return valid;
+}
+
+static bool parse_range(RenderOptions *options, const char *argument) {
+  char *end = NULL;
+
+  options->learn_start = strtod(argument, &end);
+  if (end == argument || *end != ':') {
+    return false;
+  }
+
+  const char *second = end + 1;
+  options->learn_end = strtod(second, &end);
+  if (end == second || *end != '\0') {
+    return false;
+  }
+
+  options->learn = true;
+  return options->learn_start >= 0. &&
+         options->learn_end > options->learn_start;
+}
+
+static bool parse_raw_format(RenderOptions *options, const char *argument) {
+  char *end = NULL;
+
+  const unsigned long sample_rate = strtoul(argument, &end, 10);
+  if (end == argument || *end != ':') {
+    return false;
+  }
+
+  const char *second = end + 1;
+  const unsigned long channels = strtoul(second, &end, 10);
+  if (end == second || *end != '\0') {
+    return false;
+  }
+
+  options->raw = true;
+  options->raw_sample_rate = (uint32_t)sample_rate;
+  options->raw_channels = (uint32_t)channels;
+
+  return sample_rate > 0UL && channels > 0UL;
+}
+
+static bool parse_stream_format(RenderOptions *options,
+                                const char *argument) {
+  if (!strncmp(argument, "s16:", 4U)) {
+    options->stream_format = RENDER_PCM_S16;
+  } else if (!strncmp(argument, "s32:", 4U)) {
+    options->stream_format = RENDER_PCM_S32;
+  } else if (!strncmp(argument, "f32:", 4U)) {
+    options->stream_format = RENDER_PCM_F32;
+  } else {
+    return false;
+  }
+
+  // Same RATE:CHANNELS syntax as raw files
+  RenderOptions format = *options;
+  if (!parse_raw_format(&format, argument + 4)) {
+    return false;
+  }
+
+  options->stream = true;
+  options->stream_sample_rate = format.raw_sample_rate;
+  options->stream_channels = format.raw_channels;
+
+  return true;
+}
+
+static bool is_directory(const char *path) {
+  struct stat status;
+  return stat(path, &status) == 0 && S_ISDIR(status.st_mode);
+}
+
+static bool get_output_path(const RenderOptions *options, const char *input,
+                            char *path) {
+  if (!is_directory(options->output)) {
+    return snprintf(path, MAXIMUM_PATH, "%s", options->output) <
+           (int)MAXIMUM_PATH;
+  }
+
+  const char *name = strrchr(input, '/');
+  name = name ? name + 1 : input;
+
+  return snprintf(path, MAXIMUM_PATH, "%s/%s", options->output, name) <
+         (int)MAXIMUM_PATH;
+}
+
+static void render_buffers_free(RenderBuffers *self) {
+  for (uint32_t c = 0U; c < self->channels; c++) {
+    if (self->input) {
+      free(self->input[c]);
+    }
+    if (self->output) {
+      free(self->output[c]);
+    }
+  }
+
+  free(self->interleaved);
+  free(self->input);
+  free(self->output);
+  free(self->cursor);
+}
+
+static bool render_buffers_initialize(RenderBuffers *self,
+                                      const uint32_t channels) {
+  memset(self, 0, sizeof(RenderBuffers));
+
+  self->interleaved =
+      (float *)calloc((size_t)BLOCK_FRAMES * channels, sizeof(float));
+  self->input = (float **)calloc(channels, sizeof(float *));
+  self->output = (float **)calloc(channels, sizeof(float *));
+  self->cursor = (const float **)calloc(channels, sizeof(float *));
+  if (!self->interleaved || !self->input || !self->output || !self->cursor) {
+    render_buffers_free(self);
+    return false;
+  }
+
+  self->kernels = simd_kernels_get();
+  self->channels = channels;
+  for (uint32_t c = 0U; c < channels; c++) {
+    self->input[c] = (float *)calloc(BLOCK_FRAMES, sizeof(float));
+    self->output[c] = (float *)calloc(BLOCK_FRAMES, sizeof(float));
+    if (!self->input[c] || !self->output[c]) {
+      render_buffers_free(self);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void deinterleave(RenderBuffers *self, const float *source,
+                         const uint32_t frames) {
+  self->kernels->deinterleave(source, self->channels, self->input, frames);
+}
+
+static void interleave(RenderBuffers *self, float *destination,
+                       const uint32_t first, const uint32_t frames) {
+  for (uint32_t c = 0U; c < self->channels; c++) {
+    self->cursor[c] = &self->output[c][first];
+  }
+
+  self->kernels->interleave(self->cursor, self->channels, destination,
+                            frames - first);
+}
+
+static void process(RenderPlugin *plugin, RenderBuffers *buffers,
+                    const uint32_t frames) {
+  render_plugin_process(plugin, frames, (const float *const *)buffers->input,
+                        buffers->output);
+}
+
+static bool apply_settings(const RenderOptions *options,
+                           RenderPlugin *plugin) {
+  for (uint32_t i = 0U; i < options->number_of_settings; i++) {
+    if (!render_plugin_set_control(plugin, options->settings[i].symbol,
+                                   options->settings[i].value)) {
+      fprintf(stderr, "Unknown control <%s>\n", options->settings[i].symbol);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Raw files carry no header, libsndfile is told what they hold
+static SNDFILE *open_sound(const RenderOptions *options, const char *path,
+                           SF_INFO *info) {
+  memset(info, 0, sizeof(SF_INFO));
+
+  if (options->raw) {
+    info->samplerate = (int)options->raw_sample_rate;
+    info->channels = (int)options->raw_channels;
+    info->format = SF_FORMAT_RAW | SF_FORMAT_FLOAT;
+  }
+
+  return sf_open(path, SFM_READ, info);
+}
+
+static size_t get_job_memory(const RenderOptions *options,
+                             const SF_INFO *info) {
+  return render_plugin_estimate_memory(options->type,
+                                       (uint32_t)info->samplerate,
+                                       (uint32_t)info->channels) +
+         sizeof(float) * 3U * BLOCK_FRAMES * (size_t)info->channels;
+}
+
+// Feeds the learning instance from the current position of the file up to
+// end, returns where it stopped
+static sf_count_t learn_until(const RenderBatch *batch, SNDFILE *file,
+                              const SF_INFO *info, RenderPlugin *plugin,
+                              RenderBuffers *buffers, sf_count_t position,
+                              const sf_count_t end) {
+  while (position < end) {
+    const sf_count_t wanted =
+        end - position < BLOCK_FRAMES ? end - position : BLOCK_FRAMES;
+    const sf_count_t frames =
+        sf_readf_float(file, buffers->interleaved, wanted);
+    if (frames <= 0) {
+      break;
+    }
+
+    deinterleave(buffers, buffers->interleaved, (uint32_t)frames);
+    process(plugin, buffers, (uint32_t)frames);
+    render_jobs_report(batch->jobs, (uint64_t)frames,
+                       (uint32_t)info->samplerate);
+    position += frames;
+  }
+
+  return position;
+}
+
+// Equal power, the noise on both sides is uncorrelated
+static void splice(float *head, const float *tail, const sf_count_t frames,
+                   const uint32_t channels) {
+  for (sf_count_t k = 0; k < frames; k++) {
+    const float phase = HALF_PI * ((float)k + 0.5F) / (float)frames;
+    const float fade_in = sinf(phase);
+    const float fade_out = cosf(phase);
+
+    for (uint32_t c = 0U; c < channels; c++) {
+      const size_t i = (size_t)k * channels + c;
+      head[i] = head[i] * fade_in + tail[i] * fade_out;
+    }
+  }
+}
+
+// Learning runs on its own instance so none of the learned audio is left in
+// the buffers of the one that renders. Without ranges the --learn seconds are
+// used. Ranges that don't follow each other are crossfaded over the latency,
+// so the jump between them never reaches the profile as a transient.
+static RenderState *learn_profile(const RenderBatch *batch, const char *path,
+                                  const RenderRange *ranges,
+                                  uint32_t number_of_ranges) {
+  const RenderOptions *options = batch->options;
+  SF_INFO info;
+  SNDFILE *file = open_sound(options, path, &info);
+  if (!file) {
+    fprintf(stderr, "Cannot open <%s>: %s\n", path, sf_strerror(NULL));
+    return NULL;
+  }
+
+  const size_t memory = get_job_memory(options, &info);
+  render_jobs_reserve(batch->jobs, memory);
+
+  RenderPlugin *plugin = render_plugin_initialize(
+      options->type, (uint32_t)info.samplerate, (uint32_t)info.channels);
+  RenderBuffers buffers;
+  RenderState *state = NULL;
+
+  if (!plugin || !render_buffers_initialize(&buffers, info.channels)) {
+    if (plugin) {
+      render_plugin_free(plugin);
+    }
+    render_jobs_release(batch->jobs, memory);
+    sf_close(file);
+    return NULL;
+  }
+
+  const RenderRange requested = {
+      (sf_count_t)(options->learn_start * info.samplerate),
+      (sf_count_t)(options->learn_end * info.samplerate)};
+  if (!ranges) {
+    ranges = &requested;
+    number_of_ranges = 1U;
+  }
+
+  const uint32_t latency = render_plugin_get_latency(plugin);
+  const sf_count_t fade = latency < BLOCK_FRAMES ? latency : BLOCK_FRAMES;
+  float *tail = number_of_ranges > 1U && fade > 0
+                    ? (float *)calloc((size_t)fade * info.channels,
+                                      sizeof(float))
+                    : NULL;
+  sf_count_t held = 0;
+
+  if (apply_settings(options, plugin)) {
+    render_plugin_set_control(plugin, "noise_learn", options->learn_mode);
+
+    for (uint32_t r = 0U; r < number_of_ranges; r++) {
+      sf_count_t position = ranges[r].start;
+      const sf_count_t end = ranges[r].end;
+      if (sf_seek(file, position, SEEK_SET) != position) {
+        break;
+      }
+
+      // The held tail of the previous range fades into this one
+      if (held > 0) {
+        const sf_count_t wanted = end - position < held ? end - position : held;
+        const sf_count_t frames =
+            sf_readf_float(file, buffers.interleaved, wanted);
+        if (frames > 0) {
+          splice(buffers.interleaved, tail, frames, (uint32_t)info.channels);
+          deinterleave(&buffers, buffers.interleaved, (uint32_t)frames);
+          process(plugin, &buffers, (uint32_t)frames);
+          render_jobs_report(batch->jobs, (uint64_t)frames,
+                             (uint32_t)info.samplerate);
+          position += frames;
+        }
+        held = 0;
+      }
+
+      const bool jumps = tail && r + 1U < number_of_ranges &&
+                         ranges[r + 1U].start != end;
+      const sf_count_t kept =
+          jumps ? (end - position < fade ? end - position : fade) : 0;
+
+      position = learn_until(batch, file, &info, plugin, &buffers, position,
+                             end - kept);
+      if (kept > 0 && position == end - kept) {
+        held = sf_readf_float(file, tail, kept);
+        held = held > 0 ? held : 0;
+      }
+    }
+
+    // Nothing follows the last tail
+    if (held > 0) {
+      deinterleave(&buffers, tail, (uint32_t)held);
+      process(plugin, &buffers, (uint32_t)held);
+      render_jobs_report(batch->jobs, (uint64_t)held,
+                         (uint32_t)info.samplerate);
+    }
+
+    // An empty run with learning off finalizes the profile
+    render_plugin_set_control(plugin, "noise_learn", 0.F);
+    process(plugin, &buffers, 0U);
+
+    state = render_state_initialize();
+    if (state && !render_plugin_save_state(plugin, state)) {
+      render_state_free(state);
+      state = NULL;
+    }
+  }
+
+  if (!state) {
+    fprintf(stderr, "Cannot learn a noise profile from <%s>\n", path);
+  }
+
+  free(tail);
+  render_buffers_free(&buffers);
+  render_plugin_free(plugin);
+  render_jobs_release(batch->jobs, memory);
+  sf_close(file);
+
+  return state;
+}
+
+typedef struct RenderStream {
+  const RenderBatch *batch;
+  SNDFILE *input;
+  SNDFILE *output;
+  RenderPlugin *plugin;
+  RenderBuffers buffers;
+  uint32_t sample_rate;
+  uint32_t flush; // Silent frames still to feed once the input ends
+  uint32_t skip;  // Output frames still to drop
+  bool input_done;
+  RenderSampleFormat pcm_format;
+  unsigned char *pcm_scratch;
+} RenderStream;
+
+static uint32_t read_silence(RenderStream *self, float *block,
+                             const uint32_t frames) {
+  const uint32_t silence = self->flush < frames ? self->flush : frames;
+  memset(block, 0, sizeof(float) * silence * self->buffers.channels);
+  self->flush -= silence;
+
+  return silence;
+}
+
+static uint32_t read_stream(void *context, float *block,
+                            const uint32_t frames) {
+  RenderStream *self = (RenderStream *)context;
+
+  if (!self->input_done) {
+    const sf_count_t read = sf_readf_float(self->input, block, frames);
+    if (read > 0) {
+      render_jobs_report(self->batch->jobs, (uint64_t)read,
+                         self->sample_rate);
+      return (uint32_t)read;
+    }
+    self->input_done = true;
+  }
+
+  return read_silence(self, block, frames);
+}
+
+static uint32_t process_stream(void *context, float *block,
+                               const uint32_t frames, uint32_t *first) {
+  RenderStream *self = (RenderStream *)context;
+  const uint32_t channels = self->buffers.channels;
+
+  for (uint32_t k = 0U; k < frames; k += BLOCK_FRAMES) {
+    const uint32_t chunk =
+        frames - k < BLOCK_FRAMES ? frames - k : BLOCK_FRAMES;
+    float *samples = &block[(size_t)k * channels];
+
+    deinterleave(&self->buffers, samples, chunk);
+    process(self->plugin, &self->buffers, chunk);
+    interleave(&self->buffers, samples, 0U, chunk);
+  }
+
+  *first = self->skip < frames ? self->skip : frames;
+  self->skip -= *first;
+
+  return frames - *first;
+}
+
+static bool write_stream(void *context, const float *block,
+                         const uint32_t frames) {
+  RenderStream *self = (RenderStream *)context;
+  return sf_writef_float(self->output, block, (sf_count_t)frames) ==
+         (sf_count_t)frames;
+}
+
+static uint32_t get_sample_size(const RenderSampleFormat format) {
+  return format == RENDER_PCM_S16 ? 2U : 4U;
+}
+
+// Samples are read in the space of the floats they become, so converting
+// from the last one backwards never overwrites one still to be read
+static uint32_t read_pcm(void *context, float *block, const uint32_t frames) {
+  RenderStream *self = (RenderStream *)context;
+  const uint32_t channels = self->buffers.channels;
+  const uint32_t sample_size = get_sample_size(self->pcm_format);
+
+  if (!self->input_done) {
+    const size_t read =
+        fread(block, (size_t)sample_size * channels, frames, stdin);
+    if (read > 0U) {
+      const unsigned char *bytes = (const unsigned char *)block;
+
+      for (size_t i = read * channels; i-- > 0U;) {
+        if (self->pcm_format == RENDER_PCM_S16) {
+          int16_t sample = 0;
+          memcpy(&sample, &bytes[i * sample_size], sizeof(int16_t));
+          block[i] = (float)sample * (1.F / 32768.F);
+        } else if (self->pcm_format == RENDER_PCM_S32) {
+          int32_t sample = 0;
+          memcpy(&sample, &bytes[i * sample_size], sizeof(int32_t));
+          block[i] = (float)((double)sample * (1. / 2147483648.));
+        }
+      }
+
+      render_jobs_report(self->batch->jobs, (uint64_t)read,
+                         self->sample_rate);
+      return (uint32_t)read;
+    }
+    self->input_done = true;
+  }
+
+  return read_silence(self, block, frames);
+}
+
+static bool write_pcm(void *context, const float *block,
+                      const uint32_t frames) {
+  RenderStream *self = (RenderStream *)context;
+  const uint32_t channels = self->buffers.channels;
+  const uint32_t sample_size = get_sample_size(self->pcm_format);
+
+  for (uint32_t k = 0U; k < frames; k += BLOCK_FRAMES) {
+    const uint32_t chunk =
+        frames - k < BLOCK_FRAMES ? frames - k : BLOCK_FRAMES;
+    const float *samples = &block[(size_t)k * channels];
+    const size_t count = (size_t)chunk * channels;
+
+    for (size_t i = 0U; i < count; i++) {
+      if (self->pcm_format == RENDER_PCM_S16) {
+        const int16_t sample =
+            (int16_t)lrintf(fminf(fmaxf(samples[i] * 32768.F, -32768.F),
+                                  32767.F));
+        memcpy(&self->pcm_scratch[i * sample_size], &sample,
+               sizeof(int16_t));
+      } else if (self->pcm_format == RENDER_PCM_S32) {
+        const int32_t sample = (int32_t)llrint(
+            fmin(fmax((double)samples[i] * 2147483648., -2147483648.),
+                 2147483647.));
+        memcpy(&self->pcm_scratch[i * sample_size], &sample,
+               sizeof(int32_t));
+      } else {
+        memcpy(&self->pcm_scratch[i * sample_size], &samples[i],
+               sizeof(float));
+      }
+    }
+
+    if (fwrite(self->pcm_scratch, sample_size, count, stdout) != count) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Filter mode for shell pipelines. Memory stays the pipeline blocks and one
+// conversion block whatever the length of the stream.
+static bool render_pcm_stream(const RenderBatch *batch,
+                              const RenderState *profile) {
+  const RenderOptions *options = batch->options;
+  const uint32_t channels = options->stream_channels;
+
+  RenderStream stream;
+  memset(&stream, 0, sizeof(RenderStream));
+  stream.batch = batch;
+  stream.sample_rate = options->stream_sample_rate;
+  stream.pcm_format = options->stream_format;
+
+  stream.plugin = render_plugin_initialize(options->type,
+                                           options->stream_sample_rate,
+                                           channels);
+  if (!stream.plugin) {
+    fprintf(stderr, "Cannot instantiate the plugin\n");
+    return false;
+  }
+
+  stream.pcm_scratch = (unsigned char *)calloc(
+      (size_t)BLOCK_FRAMES * channels, sizeof(float));
+  bool rendered = stream.pcm_scratch &&
+                  render_buffers_initialize(&stream.buffers, channels);
+
+  if (rendered) {
+    rendered = apply_settings(options, stream.plugin) &&
+               (!profile || render_plugin_restore_state(stream.plugin, profile));
+
+    if (rendered) {
+      stream.skip = render_plugin_get_latency(stream.plugin);
+      stream.flush = stream.skip;
+
+      const RenderPipelineStages stages = {read_pcm, process_stream,
+                                           write_pcm, &stream};
+      rendered = render_pipeline_run(channels, stages) && fflush(stdout) == 0;
+    }
+
+    render_buffers_free(&stream.buffers);
+  }
+
+  if (!rendered) {
+    fprintf(stderr, "Cannot render the stream\n");
+  }
+
+  free(stream.pcm_scratch);
+  render_plugin_free(stream.plugin);
+
+  return rendered;
+}
+
+// Archives are read once from start to end, tell the kernel so it reads
+// further ahead
+static SNDFILE *open_input(const char *path, SF_INFO *info) {
+  const int descriptor = open(path, O_RDONLY);
+  if (descriptor < 0) {
+    return NULL;
+  }
+
+#if defined(POSIX_FADV_SEQUENTIAL)
+  posix_fadvise(descriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+  SNDFILE *file = sf_open_fd(descriptor, SFM_READ, info, SF_TRUE);
+  if (!file) {
+    close(descriptor);
+  }
+
+  return file;
+}
+
+// Output keeps the input format. The first latency frames are dropped and
+// the same amount is flushed at the end, so both files line up. Reading,
+// processing and writing run on three threads.
+static bool render_file(const RenderBatch *batch, const char *input_path,
+                        const char *output_path, const RenderState *profile) {
+  const RenderOptions *options = batch->options;
+  RenderStream stream;
+  memset(&stream, 0, sizeof(RenderStream));
+  stream.batch = batch;
+
+  SF_INFO info;
+  memset(&info, 0, sizeof(SF_INFO));
+
+  stream.input = open_input(input_path, &info);
+  if (!stream.input) {
+    fprintf(stderr, "Cannot open <%s>: %s\n", input_path, sf_strerror(NULL));
+    return false;
+  }
+  stream.sample_rate = (uint32_t)info.samplerate;
+
+  const size_t memory =
+      get_job_memory(options, &info) +
+      render_pipeline_estimate_memory((uint32_t)info.channels);
+  render_jobs_reserve(batch->jobs, memory);
+
+  stream.plugin = render_plugin_initialize(
+      options->type, (uint32_t)info.samplerate, (uint32_t)info.channels);
+  if (!stream.plugin) {
+    fprintf(stderr, "Cannot instantiate the plugin for <%s>\n", input_path);
+    render_jobs_release(batch->jobs, memory);
+    sf_close(stream.input);
+    return false;
+  }
+
+  if (!render_buffers_initialize(&stream.buffers, info.channels)) {
+    render_plugin_free(stream.plugin);
+    render_jobs_release(batch->jobs, memory);
+    sf_close(stream.input);
+    return false;
+  }
+
+  bool rendered = apply_settings(options, stream.plugin);
+
+  if (rendered && profile &&
+      !render_plugin_restore_state(stream.plugin, profile)) {
+    fprintf(stderr, "Noise profile does not fit <%s>\n", input_path);
+    rendered = false;
+  }
+
+  SF_INFO output_info = info;
+  output_info.frames = 0;
+  stream.output =
+      rendered ? sf_open(output_path, SFM_WRITE, &output_info) : NULL;
+  if (rendered && !stream.output) {
+    fprintf(stderr, "Cannot create <%s>: %s\n", output_path,
+            sf_strerror(NULL));
+    rendered = false;
+  }
+
+  if (rendered) {
+    sf_command(stream.output, SFC_SET_CLIPPING, NULL, SF_TRUE);
+
+    stream.skip = render_plugin_get_latency(stream.plugin);
+    stream.flush = stream.skip;
+
+    const RenderPipelineStages stages = {read_stream, process_stream,
+                                         write_stream, &stream};
+    rendered = render_pipeline_run((uint32_t)info.channels, stages);
+
+    if (!rendered) {
+      fprintf(stderr, "Cannot write <%s>\n", output_path);
+    }
+
+    sf_close(stream.output);
+  }
+
+  render_buffers_free(&stream.buffers);
+  render_plugin_free(stream.plugin);
+  render_jobs_release(batch->jobs, memory);
+  sf_close(stream.input);
+
+  return rendered;
+}
+
+// A sparse output would only run out of space while the mapping is written,
+// as a SIGBUS. The blocks are reserved up front where the file system can.
+static int allocate_output(const int descriptor, const size_t bytes) {
+  if (bytes == 0U) {
+    return 0;
+  }
+
+  const int error = posix_fallocate(descriptor, 0, (off_t)bytes);
+  if (error != EOPNOTSUPP) {
+    return error;
+  }
+
+  return ftruncate(descriptor, (off_t)bytes) == 0 ? 0 : errno;
+}
+
+// Raw float files are mapped. Input frames go straight from the mapping to
+// the plugin buffers, and results straight into the mapped output.
+static bool render_mapped_file(const RenderBatch *batch,
+                               const char *input_path,
+                               const char *output_path,
+                               const RenderState *profile) {
+  const RenderOptions *options = batch->options;
+  const uint32_t channels = options->raw_channels;
+  const size_t frame_size = sizeof(float) * channels;
+
+  const int input_descriptor = open(input_path, O_RDONLY);
+  struct stat status;
+  if (input_descriptor < 0 || fstat(input_descriptor, &status) != 0) {
+    fprintf(stderr, "Cannot open <%s>\n", input_path);
+    if (input_descriptor >= 0) {
+      close(input_descriptor);
+    }
+    return false;
+  }
+
+  const size_t frames = (size_t)status.st_size / frame_size;
+  const size_t bytes = frames * frame_size;
+
+  const int output_descriptor =
+      open(output_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  const int error =
+      output_descriptor < 0 ? errno : allocate_output(output_descriptor, bytes);
+  if (error != 0) {
+    fprintf(stderr, "Cannot create <%s>: %s\n", output_path, strerror(error));
+    if (output_descriptor >= 0) {
+      close(output_descriptor);
+      unlink(output_path);
+    }
+    close(input_descriptor);
+    return false;
+  }
+
+  // Nothing to map for an empty file, its empty output is already there
+  if (frames == 0U) {
+    close(output_descriptor);
+    close(input_descriptor);
+    return true;
+  }
+
+  const float *input = (const float *)mmap(NULL, bytes, PROT_READ, MAP_SHARED,
+                                           input_descriptor, 0);
+  float *output = (float *)mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                                MAP_SHARED, output_descriptor, 0);
+  close(input_descriptor);
+  close(output_descriptor);
+
+  if (input == (const float *)MAP_FAILED || output == (float *)MAP_FAILED) {
+    fprintf(stderr, "Cannot map <%s>\n", input_path);
+    if (input != (const float *)MAP_FAILED) {
+      munmap((void *)input, bytes);
+    }
+    if (output != (float *)MAP_FAILED) {
+      munmap(output, bytes);
+    }
+    unlink(output_path);
+    return false;
+  }
+
+  posix_madvise((void *)input, bytes, POSIX_MADV_SEQUENTIAL);
+  posix_madvise(output, bytes, POSIX_MADV_SEQUENTIAL);
+
+  const size_t memory =
+      render_plugin_estimate_memory(options->type, options->raw_sample_rate,
+                                    channels) +
+      sizeof(float) * 2U * BLOCK_FRAMES * channels;
+  render_jobs_reserve(batch->jobs, memory);
+
+  RenderPlugin *plugin = render_plugin_initialize(
+      options->type, options->raw_sample_rate, channels);
+  RenderBuffers buffers;
+  bool rendered = false;
+
+  if (plugin && render_buffers_initialize(&buffers, channels)) {
+    rendered = apply_settings(options, plugin) &&
+               (!profile || render_plugin_restore_state(plugin, profile));
+
+    // Output frame k comes out latency frames after input frame k
+    const size_t latency = render_plugin_get_latency(plugin);
+
+    for (size_t position = 0U; rendered && position < frames + latency;
+         position += BLOCK_FRAMES) {
+      const size_t chunk = frames + latency - position < BLOCK_FRAMES
+                               ? frames + latency - position
+                               : BLOCK_FRAMES;
+      const size_t available =
+          position < frames ? (frames - position < chunk ? frames - position
+                                                          : chunk)
+                            : 0U;
+
+      if (available > 0U) {
+        deinterleave(&buffers, &input[position * channels],
+                     (uint32_t)available);
+      }
+      for (uint32_t c = 0U; c < channels; c++) {
+        memset(&buffers.input[c][available], 0,
+               sizeof(float) * (chunk - available));
+      }
+
+      process(plugin, &buffers, (uint32_t)chunk);
+      render_jobs_report(batch->jobs, (uint64_t)available,
+                         options->raw_sample_rate);
+
+      const size_t first =
+          position < latency ? (latency - position < chunk
+                                    ? latency - position
+                                    : chunk)
+                             : 0U;
+      if (first < chunk) {
+        interleave(&buffers, &output[(position + first - latency) * channels],
+                   (uint32_t)first, (uint32_t)chunk);
+      }
+    }
+
+    render_buffers_free(&buffers);
+  }
+
+  if (plugin) {
+    render_plugin_free(plugin);
+  }
+  render_jobs_release(batch->jobs, memory);
+
+  munmap((void *)input, bytes);
+  if (msync(output, bytes, MS_ASYNC) != 0) {
+    rendered = false;
+  }
+  munmap(output, bytes);
+
+  if (!rendered) {
+    unlink(output_path);
+  }
+
+  return rendered;
+}
+
+static bool write_part(FILE *part, RenderBuffers *buffers,
+                       const uint32_t first, const uint32_t frames) {
+  interleave(buffers, buffers->interleaved, first, frames);
+
+  const size_t samples = (size_t)(frames - first) * buffers->channels;
+  return fwrite(buffers->interleaved, sizeof(float), samples, part) ==
+         samples;
+}
+
+// Renders one segment of a file into its part. The instance starts warmup
+// frames earlier, on a multiple of the latency so it sees the same STFT
+// frames as a serial render, and reads latency frames past the end.
+static bool render_segment(void *context, const uint32_t segment) {
+  const RenderSegments *self = (const RenderSegments *)context;
+  const RenderOptions *options = self->batch->options;
+
+  SF_INFO info;
+  SNDFILE *input = open_sound(options, self->input_path, &info);
+  if (!input) {
+    return false;
+  }
+
+  const size_t memory = get_job_memory(options, &info);
+  render_jobs_reserve(self->batch->jobs, memory);
+
+  RenderPlugin *plugin = render_plugin_initialize(
+      options->type, (uint32_t)info.samplerate, (uint32_t)info.channels);
+  RenderBuffers buffers;
+  bool rendered = false;
+
+  if (plugin && render_buffers_initialize(&buffers, info.channels)) {
+    rendered = apply_settings(options, plugin) &&
+               (!self->profile ||
+                render_plugin_restore_state(plugin, self->profile));
+
+    const sf_count_t start = self->boundaries[segment];
+    const sf_count_t end = self->boundaries[segment + 1U];
+    const sf_count_t latency = (sf_count_t)render_plugin_get_latency(plugin);
+
+    sf_count_t position = start > self->warmup ? start - self->warmup : 0;
+    if (latency > 0) {
+      position -= position % latency;
+    }
+
+    sf_count_t skip = start - position + latency;
+    sf_count_t keep = end - start;
+
+    rendered = rendered && sf_seek(input, position, SEEK_SET) == position;
+
+    while (rendered && keep > 0) {
+      const sf_count_t wanted = end + latency - position < BLOCK_FRAMES
+                                    ? end + latency - position
+                                    : BLOCK_FRAMES;
+      sf_count_t available = self->total_frames - position;
+      if (available > wanted) {
+        available = wanted;
+      }
+
+      // Past the end of the file the instance is flushed with silence
+      const sf_count_t frames =
+          available > 0 ? sf_readf_float(input, buffers.interleaved, available)
+                        : 0;
+      memset(&buffers.interleaved[frames * info.channels], 0,
+             sizeof(float) * (size_t)((wanted - frames) * info.channels));
+
+      deinterleave(&buffers, buffers.interleaved, (uint32_t)wanted);
+      process(plugin, &buffers, (uint32_t)wanted);
+      render_jobs_report(self->batch->jobs, (uint64_t)frames,
+                         (uint32_t)info.samplerate);
+
+      const sf_count_t first = skip < wanted ? skip : wanted;
+      const sf_count_t count = wanted - first < keep ? wanted - first : keep;
+      skip -= first;
+
+      if (count > 0) {
+        rendered = write_part(self->parts[segment], &buffers, (uint32_t)first,
+                              (uint32_t)(first + count));
+        keep -= count;
+      }
+
+      position += wanted;
+    }
+
+    render_buffers_free(&buffers);
+  }
+
+  if (plugin) {
+    render_plugin_free(plugin);
+  }
+  render_jobs_release(self->batch->jobs, memory);
+  sf_close(input);
+
+  return rendered;
+}
+
+static FILE *open_part(const char *output_path) {
+  char path[MAXIMUM_PATH];
+  if (snprintf(path, sizeof(path), "%s.segmentXXXXXX", output_path) >=
+      (int)sizeof(path)) {
+    return NULL;
+  }
+
+  // Next to the output, temporary space may be too small for long files
+  const int descriptor = mkstemp(path);
+  if (descriptor < 0) {
+    return NULL;
+  }
+  unlink(path);
+
+  FILE *part = fdopen(descriptor, "w+b");
+  if (!part) {
+    close(descriptor);
+  }
+
+  return part;
+}
+
+static void close_parts(RenderSegments *self) {
+  for (uint32_t k = 0U; self->parts && k < self->number_of_segments; k++) {
+    if (self->parts[k]) {
+      fclose(self->parts[k]);
+    }
+  }
+
+  free(self->parts);
+  free(self->boundaries);
+}
+
+static bool open_parts(RenderSegments *self, const char *output_path,
+                       const uint32_t number_of_segments) {
+  self->number_of_segments = number_of_segments;
+  self->boundaries =
+      (sf_count_t *)calloc(number_of_segments + 1U, sizeof(sf_count_t));
+  self->parts = (FILE **)calloc(number_of_segments, sizeof(FILE *));
+  if (!self->boundaries || !self->parts) {
+    return false;
+  }
+
+  for (uint32_t k = 0U; k <= number_of_segments; k++) {
+    self->boundaries[k] =
+        self->total_frames * (sf_count_t)k / (sf_count_t)number_of_segments;
+  }
+
+  for (uint32_t k = 0U; k < number_of_segments; k++) {
+    self->parts[k] = open_part(output_path);
+    if (!self->parts[k]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool stitch_parts(const RenderSegments *self, const char *output_path,
+                         SF_INFO info) {
+  info.frames = 0;
+  SNDFILE *output = sf_open(output_path, SFM_WRITE, &info);
+  if (!output) {
+    fprintf(stderr, "Cannot create <%s>: %s\n", output_path,
+            sf_strerror(NULL));
+    return false;
+  }
+  sf_command(output, SFC_SET_CLIPPING, NULL, SF_TRUE);
+
+  float *block =
+      (float *)calloc((size_t)BLOCK_FRAMES * info.channels, sizeof(float));
+  bool written = block != NULL;
+
+  for (uint32_t k = 0U; written && k < self->number_of_segments; k++) {
+    rewind(self->parts[k]);
+
+    size_t samples = 0U;
+    while (written && (samples = fread(block, sizeof(float),
+                                       (size_t)BLOCK_FRAMES * info.channels,
+                                       self->parts[k])) > 0U) {
+      const sf_count_t frames = (sf_count_t)(samples / info.channels);
+      written = sf_writef_float(output, block, frames) == frames;
+    }
+  }
+
+  free(block);
+  sf_close(output);
+
+  return written;
+}
+
+// Reports how far the stitched render strays from a serial one, and where.
+// Fails when that is over the tolerance.
+static bool report_seams(const RenderSegments *self,
+                         const RenderSegments *serial, const char *path,
+                         const uint32_t channels, const float tolerance) {
+  float *stitched =
+      (float *)calloc((size_t)BLOCK_FRAMES * channels, sizeof(float));
+  float *reference =
+      (float *)calloc((size_t)BLOCK_FRAMES * channels, sizeof(float));
+  if (!stitched || !reference) {
+    free(stitched);
+    free(reference);
+    return false;
+  }
+
+  float maximum_error = 0.F;
+  sf_count_t maximum_frame = 0;
+  sf_count_t frame = 0;
+
+  bool matched = true;
+
+  rewind(serial->parts[0]);
+
+  for (uint32_t k = 0U; matched && k < self->number_of_segments; k++) {
+    rewind(self->parts[k]);
+
+    size_t samples = 0U;
+    while (matched && (samples = fread(stitched, sizeof(float),
+                                       (size_t)BLOCK_FRAMES * channels,
+                                       self->parts[k])) > 0U) {
+      matched = fread(reference, sizeof(float), samples, serial->parts[0]) ==
+                samples;
+      for (size_t i = 0U; matched && i < samples; i++) {
+        const float error = fabsf(stitched[i] - reference[i]);
+        if (error > maximum_error) {
+          maximum_error = error;
+          maximum_frame = frame + (sf_count_t)(i / channels);
+        }
+      }
+      frame += (sf_count_t)(samples / channels);
+    }
+  }
+
+  // Both renders cover the whole file, any difference in length is a failure
+  matched = matched && frame == self->total_frames &&
+            fgetc(serial->parts[0]) == EOF;
+
+  free(stitched);
+  free(reference);
+
+  if (!matched) {
+    fprintf(stderr,
+            "%s: the stitched and serial renders differ in length (%lld "
+            "frames stitched of %lld)\n",
+            path, (long long)frame, (long long)self->total_frames);
+    return false;
+  }
+
+  uint32_t nearest = 1U;
+  for (uint32_t k = 2U; k < self->number_of_segments; k++) {
+    if (llabs((long long)(self->boundaries[k] - maximum_frame)) <
+        llabs((long long)(self->boundaries[nearest] - maximum_frame))) {
+      nearest = k;
+    }
+  }
+
+  const float error = 20.F * log10f(fmaxf(maximum_error, 1e-12F));
+  const bool within = error <= tolerance;
+
+  fprintf(stderr, "%s: seam error %.1f dBFS at frame %lld (seam at %lld)%s\n",
+          path, error, (long long)maximum_frame,
+          (long long)self->boundaries[nearest],
+          within ? "" : ", over the tolerance");
+
+  return within;
+}
+
+// One long file is cut in segments rendered in parallel on the job pool.
+// Every segment restores the same profile, and the adaptive estimator
+// converges during the warmup that precedes it.
+static bool render_segmented(const RenderBatch *batch, const char *input_path,
+                             const char *output_path,
+                             const RenderState *profile) {
+  const RenderOptions *options = batch->options;
+
+  SF_INFO info;
+  SNDFILE *input = open_sound(options, input_path, &info);
+  if (!input) {
+    fprintf(stderr, "Cannot open <%s>: %s\n", input_path, sf_strerror(NULL));
+    return false;
+  }
+  sf_close(input);
+
+  // Segments shorter than a second would spend most of their time warming
+  const sf_count_t seconds = info.frames / info.samplerate;
+  uint32_t number_of_segments = options->segments;
+  if ((sf_count_t)number_of_segments > seconds) {
+    number_of_segments = seconds > 0 ? (uint32_t)seconds : 1U;
+  }
+
+  RenderSegments segments = {
+      batch,       input_path, profile, 0U,
+      info.frames, (sf_count_t)(options->warmup * info.samplerate),
+      NULL,        NULL};
+
+  bool rendered = open_parts(&segments, output_path, number_of_segments) &&
+                  render_jobs_run(batch->jobs, number_of_segments,
+                                  render_segment, &segments) == 0U &&
+                  stitch_parts(&segments, output_path, info);
+
+  if (rendered && options->verify_seams && number_of_segments > 1U) {
+    RenderSegments serial = {batch, input_path, profile, 0U,
+                             info.frames, 0, NULL, NULL};
+    rendered = open_parts(&serial, output_path, 1U) &&
+               render_segment(&serial, 0U) &&
+               report_seams(&segments, &serial, input_path,
+                            (uint32_t)info.channels, options->seam_tolerance);
+    close_parts(&serial);
+  }
+
+  if (!rendered) {
+    fprintf(stderr, "Cannot render <%s> in segments\n", input_path);
+  }
+
+  close_parts(&segments);
+
+  return rendered;
+}
+
+typedef struct RenderScanJob {
+  uint32_t file;
+  uint32_t first_window;
+  uint32_t number_of_windows;
+} RenderScanJob;
+
+typedef struct RenderScan {
+  const RenderOptions *options;
+  char *const *inputs;
+  RenderJobs *jobs;
+  RenderScanFile *files;
+  RenderScanJob *scan_jobs;
+} RenderScan;
+
+static bool scan_windows(void *context, const uint32_t job) {
+  const RenderScan *self = (const RenderScan *)context;
+  const RenderScanJob *scan_job = &self->scan_jobs[job];
+  const RenderScanFile *file = &self->files[scan_job->file];
+  const char *path = self->inputs[scan_job->file];
+
+  SF_INFO info;
+  SNDFILE *sound = open_sound(self->options, path, &info);
+  if (!sound) {
+    return false;
+  }
+
+  const uint32_t subframe_length =
+      (uint32_t)ceil(SCAN_SUBFRAME_SECONDS * info.samplerate);
+  float *window = (float *)calloc((size_t)file->window_frames * info.channels,
+                                  sizeof(float));
+  const sf_count_t position =
+      (sf_count_t)scan_job->first_window * file->window_frames;
+  bool scanned = window && sf_seek(sound, position, SEEK_SET) == position;
+
+  for (uint32_t i = 0U; scanned && i < scan_job->number_of_windows; i++) {
+    scanned = sf_readf_float(sound, window, file->window_frames) ==
+              file->window_frames;
+    if (scanned) {
+      file->scores[scan_job->first_window + i] = render_scan_score(
+          window, (uint32_t)info.channels, (uint32_t)file->window_frames,
+          subframe_length);
+      render_jobs_report(self->jobs, (uint64_t)file->window_frames,
+                         (uint32_t)info.samplerate);
+    }
+  }
+
+  free(window);
+  sf_close(sound);
+
+  return scanned;
+}
+
+static void free_scan_files(RenderScanFile *files,
+                            const uint32_t number_of_files) {
+  for (uint32_t i = 0U; files && i < number_of_files; i++) {
+    free(files[i].scores);
+    free(files[i].ranges);
+  }
+  free(files);
+}
+
+// First pass of --auto-learn. Every input is cut in chunks of windows which
+// are scored on the whole pool, then the quietest windows of each input are
+// kept as the ranges its profile is learned from.
+static RenderScanFile *scan_inputs(const RenderOptions *options,
+                                   char *const *inputs,
+                                   const uint32_t number_of_inputs,
+                                   const uint32_t workers) {
+  RenderScanFile *files =
+      (RenderScanFile *)calloc(number_of_inputs, sizeof(RenderScanFile));
+  if (!files) {
+    return NULL;
+  }
+
+  uint32_t number_of_jobs = 0U;
+  for (uint32_t i = 0U; i < number_of_inputs; i++) {
+    SF_INFO info;
+    SNDFILE *sound = open_sound(options, inputs[i], &info);
+    if (!sound) {
+      continue;
+    }
+    sf_close(sound);
+
+    files[i].window_frames =
+        (sf_count_t)ceil(SCAN_WINDOW_SECONDS * info.samplerate);
+    files[i].number_of_windows =
+        (uint32_t)(info.frames / files[i].window_frames);
+    files[i].scores = (float *)calloc(files[i].number_of_windows + 1U,
+                                      sizeof(float));
+    if (!files[i].scores) {
+      free_scan_files(files, number_of_inputs);
+      return NULL;
+    }
+
+    for (uint32_t w = 0U; w < files[i].number_of_windows; w++) {
+      files[i].scores[w] = INFINITY;
+    }
+    number_of_jobs += (files[i].number_of_windows + SCAN_WINDOWS_PER_JOB -
+                       1U) / SCAN_WINDOWS_PER_JOB;
+  }
+
+  RenderScan scan = {options, inputs, NULL, files, NULL};
+  scan.scan_jobs =
+      (RenderScanJob *)calloc(number_of_jobs + 1U, sizeof(RenderScanJob));
+  if (!scan.scan_jobs) {
+    free_scan_files(files, number_of_inputs);
+    return NULL;
+  }
+
+  uint32_t job = 0U;
+  for (uint32_t i = 0U; i < number_of_inputs; i++) {
+    for (uint32_t w = 0U; w < files[i].number_of_windows;
+         w += SCAN_WINDOWS_PER_JOB) {
+      const uint32_t remaining = files[i].number_of_windows - w;
+      scan.scan_jobs[job].file = i;
+      scan.scan_jobs[job].first_window = w;
+      scan.scan_jobs[job].number_of_windows =
+          remaining < SCAN_WINDOWS_PER_JOB ? remaining : SCAN_WINDOWS_PER_JOB;
+      job++;
+    }
+  }
+
+  scan.jobs = number_of_jobs > 0U
+                  ? render_jobs_initialize(
+                        workers < number_of_jobs ? workers : number_of_jobs,
+                        options->deterministic, 0U, options->progress)
+                  : NULL;
+  if (scan.jobs) {
+    // A chunk that fails leaves its windows out of the ranking
+    render_jobs_run(scan.jobs, number_of_jobs, scan_windows, &scan);
+    render_jobs_free(scan.jobs);
+  }
+  free(scan.scan_jobs);
+
+  const uint32_t wanted =
+      (uint32_t)ceil(options->auto_learn / SCAN_WINDOW_SECONDS);
+
+  for (uint32_t i = 0U; i < number_of_inputs; i++) {
+    RenderScanRange *ranges =
+        (RenderScanRange *)calloc(wanted, sizeof(RenderScanRange));
+    files[i].ranges = (RenderRange *)calloc(wanted, sizeof(RenderRange));
+    if (ranges && files[i].ranges) {
+      files[i].number_of_ranges = render_scan_select(
+          files[i].scores, files[i].number_of_windows, wanted, ranges);
+    }
+
+    for (uint32_t r = 0U; r < files[i].number_of_ranges; r++) {
+      files[i].ranges[r].start =
+          (sf_count_t)ranges[r].first_window * files[i].window_frames;
+      files[i].ranges[r].end =
+          files[i].ranges[r].start +
+          (sf_count_t)ranges[r].number_of_windows * files[i].window_frames;
+    }
+    free(ranges);
+  }
+
+  return files;
+}
+
+static bool render_input(void *context, const uint32_t job) {
+  const RenderBatch *batch = (const RenderBatch *)context;
+  const RenderOptions *options = batch->options;
+  const char *input_path = batch->inputs[job];
+
+  char output_path[MAXIMUM_PATH];
+  if (!get_output_path(options, input_path, output_path)) {
+    fprintf(stderr, "Output path too long for <%s>\n", input_path);
+    return false;
+  }
+
+  if (!strcmp(input_path, output_path)) {
+    fprintf(stderr, "Refusing to overwrite <%s>\n", input_path);
+    return false;
+  }
+
+  RenderState *learned = NULL;
+  if (options->learn) {
+    learned = learn_profile(batch, input_path, NULL, 0U);
+  } else if (options->auto_learn > 0.) {
+    const RenderScanFile *scan = &batch->scan[job];
+    if (scan->number_of_ranges == 0U) {
+      fprintf(stderr, "No noise to learn from in <%s>\n", input_path);
+      return false;
+    }
+    learned = learn_profile(batch, input_path, scan->ranges,
+                            scan->number_of_ranges);
+  }
+
+  if (options->learn || options->auto_learn > 0.) {
+    if (!learned) {
+      return false;
+    }
+
+    if (options->save_profile &&
+        !render_state_save(learned, options->save_profile)) {
+      fprintf(stderr, "Cannot save the profile to <%s>\n",
+              options->save_profile);
+    }
+  }
+
+  const RenderState *profile = learned ? learned : batch->profile;
+  bool rendered = false;
+  if (options->segments > 1U) {
+    rendered = render_segmented(batch, input_path, output_path, profile);
+  } else if (options->raw) {
+    rendered = render_mapped_file(batch, input_path, output_path, profile);
+  } else {
+    rendered = render_file(batch, input_path, output_path, profile);
+  }
+
+  if (learned) {
+    render_state_free(learned);
+  }
+
+  return rendered;
+}
+
+static int render_stream_main(const RenderOptions *options,
+                              const int number_of_inputs) {
+  if (number_of_inputs > 0 || options->output || options->learn ||
+      options->auto_learn > 0. || options->segments > 1U || options->raw) {
+    fprintf(stderr, "--stream reads stdin and writes stdout, it takes no "
+                    "files, --learn, --auto-learn, --segments nor "
+                    "--raw-f32\n");
+    return EXIT_FAILURE;
+  }
+
+  if (options->type == RENDER_PLUGIN_ADAPTIVE && options->profile) {
+    fprintf(stderr, "The adaptive plugin does not use a noise profile\n");
+    return EXIT_FAILURE;
+  }
+
+  RenderState *profile = NULL;
+  if (options->profile) {
+    profile = render_state_load(options->profile);
+    if (!profile) {
+      fprintf(stderr, "Cannot load the profile <%s>\n", options->profile);
+      return EXIT_FAILURE;
+    }
+  }
+
+  RenderBatch batch = {options, NULL, profile, NULL, NULL};
+  batch.jobs = render_jobs_initialize(1U, false, 0U, false);
+
+  const bool rendered = batch.jobs && render_pcm_stream(&batch, profile);
+
+  if (batch.jobs) {
+    render_jobs_free(batch.jobs);
+  }
+  if (profile) {
+    render_state_free(profile);
+  }
+
+  return rendered ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char **argv) {
+  RenderOptions options;
+  memset(&options, 0, sizeof(RenderOptions));
+  options.learn_mode = 1.F;
+  options.warmup = DEFAULT_WARMUP_SECONDS;
+  options.seam_tolerance = DEFAULT_SEAM_TOLERANCE;
+
+  int first_input = argc;
+  bool valid = true;
+
+  for (int i = 1; valid && i < argc; i++) {
+    const char *option = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+    if (!strcmp(option, "-h") || !strcmp(option, "--help")) {
+      usage(stdout);
+      return EXIT_SUCCESS;
+    }
+
+    if (!strcmp(option, "--deterministic")) {
+      options.deterministic = true;
+      continue;
+    }
+
+    if (!strcmp(option, "--progress")) {
+      options.progress = true;
+      continue;
+    }
+
+    if (!strcmp(option, "--verify-seams")) {
+      options.verify_seams = true;
+      continue;
+    }
+
+    if (option[0] != '-') {
+      first_input = i;
+      break;
+    }
+
+    if (!value) {
+      valid = false;
+    } else if (!strcmp(option, "-p") || !strcmp(option, "--plugin")) {
+      if (!strcmp(value, "manual")) {
+        options.type = RENDER_PLUGIN_MANUAL;
+      } else if (!strcmp(value, "adaptive")) {
+        options.type = RENDER_PLUGIN_ADAPTIVE;
+      } else {
+        valid = false;
+      }
+    } else if (!strcmp(option, "-s") || !strcmp(option, "--set")) {
+      valid = parse_setting(&options, value);
+    } else if (!strcmp(option, "--preset")) {
+      valid = load_preset(&options, value);
+    } else if (!strcmp(option, "-l") || !strcmp(option, "--learn")) {
+      valid = parse_range(&options, value);
+    } else if (!strcmp(option, "--auto-learn")) {
+      float seconds = 0.F;
+      valid = parse_float(value, &seconds) && seconds > 0.F;
+      options.auto_learn = (double)seconds;
+    } else if (!strcmp(option, "--learn-mode")) {
+      if (!strcmp(value, "average")) {
+        options.learn_mode = 1.F;
+      } else if (!strcmp(value, "median")) {
+        options.learn_mode = 2.F;
+      } else {
+        valid = false;
+      }
+    } else if (!strcmp(option, "--profile")) {
+      options.profile = value;
+    } else if (!strcmp(option, "--save-profile")) {
+      options.save_profile = value;
+    } else if (!strcmp(option, "-o") || !strcmp(option, "--output")) {
+      options.output = value;
+    } else if (!strcmp(option, "-j") || !strcmp(option, "--jobs")) {
+      float workers = 0.F;
+      valid = parse_float(value, &workers) && workers >= 1.F;
+      options.workers = (uint32_t)workers;
+    } else if (!strcmp(option, "--stream")) {
+      valid = parse_stream_format(&options, value);
+    } else if (!strcmp(option, "--raw-f32")) {
+      valid = parse_raw_format(&options, value);
+    } else if (!strcmp(option, "--segments")) {
+      float segments = 0.F;
+      valid = parse_float(value, &segments) && segments >= 1.F;
+      options.segments = (uint32_t)segments;
+    } else if (!strcmp(option, "--warmup")) {
+      float warmup = 0.F;
+      valid = parse_float(value, &warmup) && warmup >= 0.F;
+      options.warmup = (double)warmup;
+    } else if (!strcmp(option, "--seam-tolerance")) {
+      valid = parse_float(value, &options.seam_tolerance);
+    } else if (!strcmp(option, "--memory")) {
+      float megabytes = 0.F;
+      valid = parse_float(value, &megabytes) && megabytes > 0.F;
+      options.memory_budget = (size_t)megabytes * 1024U * 1024U;
+    } else {
+      valid = false;
+    }
+
+    i++;
+  }
+
+  const int number_of_inputs = argc - first_input;
+
+  if (valid && options.stream) {
+    return render_stream_main(&options, number_of_inputs);
+  }
+
+  if (!valid || !options.output || number_of_inputs == 0) {
+    usage(stderr);
+    return EXIT_FAILURE;
+  }
+
+  if (number_of_inputs > 1 && !is_directory(options.output)) {
+    fprintf(stderr, "Several inputs need an output directory\n");
+    return EXIT_FAILURE;
+  }
+
+  const bool learn = options.learn || options.auto_learn > 0.;
+
+  if (options.type == RENDER_PLUGIN_ADAPTIVE && (learn || options.profile)) {
+    fprintf(stderr, "The adaptive plugin does not use a noise profile\n");
+    return EXIT_FAILURE;
+  }
+
+  if ((options.learn ? 1 : 0) + (options.auto_learn > 0. ? 1 : 0) +
+          (options.profile ? 1 : 0) >
+      1) {
+    fprintf(stderr, "--learn, --auto-learn and --profile are exclusive\n");
+    return EXIT_FAILURE;
+  }
+
+  if (options.save_profile && (!learn || number_of_inputs > 1)) {
+    fprintf(stderr, "--save-profile needs --learn or --auto-learn and a "
+                    "single input\n");
+    return EXIT_FAILURE;
+  }
+
+  for (uint32_t i = 0U; i < options.number_of_settings; i++) {
+    if (!render_plugin_has_control(options.type,
+                                   options.settings[i].symbol)) {
+      fprintf(stderr, "Unknown control <%s>\n", options.settings[i].symbol);
+      return EXIT_FAILURE;
+    }
+  }
+
+  RenderState *profile = NULL;
+  if (options.profile) {
+    profile = render_state_load(options.profile);
+    if (!profile) {
+      fprintf(stderr, "Cannot load the profile <%s>\n", options.profile);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (options.workers == 0U) {
+    options.workers = render_jobs_get_default_workers();
+  }
+
+  RenderScanFile *scan = NULL;
+  if (options.auto_learn > 0.) {
+    scan = scan_inputs(&options, &argv[first_input],
+                       (uint32_t)number_of_inputs, options.workers);
+    if (!scan) {
+      fprintf(stderr, "Cannot scan the inputs for noise\n");
+      if (profile) {
+        render_state_free(profile);
+      }
+      return EXIT_FAILURE;
+    }
+  }
+
+  const uint32_t parallel_jobs = options.segments > 1U
+                                    ? options.segments
+                                    : (uint32_t)number_of_inputs;
+  if (options.workers > parallel_jobs) {
+    options.workers = parallel_jobs;
+  }
+
+  RenderBatch batch = {&options, &argv[first_input], profile, NULL, scan};
+  batch.jobs = render_jobs_initialize(options.workers, options.deterministic,
+                                      options.memory_budget, options.progress);
+
+  uint32_t failed = (uint32_t)number_of_inputs;
+  if (batch.jobs && options.segments > 1U) {
+    // Files one after the other, their segments spread over the pool
+    failed = 0U;
+    for (uint32_t i = 0U; i < (uint32_t)number_of_inputs; i++) {
+      if (!render_input(&batch, i)) {
+        failed++;
+      }
+    }
+  } else if (batch.jobs) {
+    failed = render_jobs_run(batch.jobs, (uint32_t)number_of_inputs,
+                             render_input, &batch);
+  }
+
+  if (batch.jobs) {
+    render_jobs_free(batch.jobs);
+  }
+
+  if (profile) {
+    render_state_free(profile);
+  }
+
+  free_scan_files(scan, (uint32_t)number_of_inputs);
+
+  if (failed > 0U) {
+    fprintf(stderr, "%u of %d files failed\n", failed, number_of_inputs);
+  }
+
+  return failed > 0U ? EXIT_FAILURE : EXIT_SUCCESS;
+}
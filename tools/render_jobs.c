@@ -0,0 +1,323 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "render_jobs.h"
+#include <errno.h>
+#include <fenv.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PROGRESS_INTERVAL_MS 1000L
+
+typedef struct RenderDeque {
+  pthread_mutex_t lock;
+  uint32_t *jobs;
+  uint32_t head;
+  uint32_t tail;
+} RenderDeque;
+
+typedef struct RenderWorker {
+  RenderJobs *pool;
+  pthread_t thread;
+  RenderDeque deque;
+  uint32_t index;
+} RenderWorker;
+
+struct RenderJobs {
+  uint32_t number_of_workers;
+  RenderWorker *workers;
+  bool deterministic;
+  bool progress;
+  fenv_t environment;
+
+  RenderJobFunction function;
+  void *context;
+
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+  size_t memory_budget;
+  size_t memory_in_use;
+  uint32_t jobs_running;
+  uint32_t jobs_total;
+  uint32_t jobs_done;
+  uint32_t jobs_failed;
+  uint64_t frames;
+  double audio_seconds;
+};
+
+static double get_time(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+uint32_t render_jobs_get_default_workers(void) {
+  const long online = sysconf(_SC_NPROCESSORS_ONLN);
+  return online > 0L ? (uint32_t)online : 1U;
+}
+
+RenderJobs *render_jobs_initialize(const uint32_t number_of_workers,
+                                   const bool deterministic,
+                                   const size_t memory_budget,
+                                   const bool progress) {
+  RenderJobs *self = (RenderJobs *)calloc(1U, sizeof(RenderJobs));
+  if (!self) {
+    return NULL;
+  }
+
+  self->number_of_workers = number_of_workers > 0U ? number_of_workers : 1U;
+  self->deterministic = deterministic;
+  self->memory_budget = memory_budget;
+  self->progress = progress;
+
+  self->workers =
+      (RenderWorker *)calloc(self->number_of_workers, sizeof(RenderWorker));
+  if (!self->workers) {
+    free(self);
+    return NULL;
+  }
+
+  pthread_mutex_init(&self->lock, NULL);
+  pthread_cond_init(&self->changed, NULL);
+
+  for (uint32_t i = 0U; i < self->number_of_workers; i++) {
+    self->workers[i].pool = self;
+    self->workers[i].index = i;
+    pthread_mutex_init(&self->workers[i].deque.lock, NULL);
+  }
+
+  return self;
+}
+
+void render_jobs_free(RenderJobs *self) {
+  for (uint32_t i = 0U; i < self->number_of_workers; i++) {
+    pthread_mutex_destroy(&self->workers[i].deque.lock);
+    free(self->workers[i].deque.jobs);
+  }
+
+  pthread_cond_destroy(&self->changed);
+  pthread_mutex_destroy(&self->lock);
+  free(self->workers);
+  free(self);
+}
+
+// The owner takes jobs from the head in the order they were given
+static bool render_deque_pop(RenderDeque *self, uint32_t *job) {
+  pthread_mutex_lock(&self->lock);
+  const bool available = self->head < self->tail;
+  if (available) {
+    *job = self->jobs[self->head++];
+  }
+  pthread_mutex_unlock(&self->lock);
+
+  return available;
+}
+
+// Thieves take from the tail, away from where the owner works
+static bool render_deque_steal(RenderDeque *self, uint32_t *job) {
+  pthread_mutex_lock(&self->lock);
+  const bool available = self->head < self->tail;
+  if (available) {
+    *job = self->jobs[--self->tail];
+  }
+  pthread_mutex_unlock(&self->lock);
+
+  return available;
+}
+
+static bool render_jobs_next(RenderWorker *worker, uint32_t *job) {
+  RenderJobs *self = worker->pool;
+
+  if (render_deque_pop(&worker->deque, job)) {
+    return true;
+  }
+
+  if (self->deterministic) {
+    return false;
+  }
+
+  for (uint32_t i = 1U; i < self->number_of_workers; i++) {
+    RenderWorker *victim =
+        &self->workers[(worker->index + i) % self->number_of_workers];
+    if (render_deque_steal(&victim->deque, job)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static void *render_jobs_work(void *data) {
+  RenderWorker *worker = (RenderWorker *)data;
+  RenderJobs *self = worker->pool;
+
+  if (self->deterministic) {
+    fesetenv(&self->environment);
+  }
+
+  uint32_t job = 0U;
+  while (render_jobs_next(worker, &job)) {
+    const bool succeeded = self->function(self->context, job);
+
+    pthread_mutex_lock(&self->lock);
+    self->jobs_done++;
+    if (!succeeded) {
+      self->jobs_failed++;
+    }
+    pthread_cond_broadcast(&self->changed);
+    pthread_mutex_unlock(&self->lock);
+  }
+
+  return NULL;
+}
+
+static void render_jobs_print_progress(const RenderJobs *self,
+                                       const double elapsed, const bool last) {
+  const double rate = elapsed > 0. ? (double)self->frames / elapsed : 0.;
+  const double realtime = elapsed > 0. ? self->audio_seconds / elapsed : 0.;
+
+  fprintf(stderr, "\r%u/%u files, %.0f frames/s, %.1fx realtime%s",
+          self->jobs_done, self->jobs_total, rate, realtime,
+          last ? "\n" : "");
+  fflush(stderr);
+}
+
+// Waits for the workers and prints the progress while they run
+static void render_jobs_wait(RenderJobs *self, const double start) {
+  pthread_mutex_lock(&self->lock);
+
+  while (self->jobs_done < self->jobs_total) {
+    if (!self->progress) {
+      pthread_cond_wait(&self->changed, &self->lock);
+      continue;
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += PROGRESS_INTERVAL_MS * 1000000L;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+    deadline.tv_nsec %= 1000000000L;
+
+    if (pthread_cond_timedwait(&self->changed, &self->lock, &deadline) ==
+        ETIMEDOUT) {
+      render_jobs_print_progress(self, get_time() - start, false);
+    }
+  }
+
+  if (self->progress) {
+    render_jobs_print_progress(self, get_time() - start, true);
+  }
+
+  pthread_mutex_unlock(&self->lock);
+}
+
+uint32_t render_jobs_run(RenderJobs *self, const uint32_t number_of_jobs,
+                         RenderJobFunction function, void *context) {
+  self->function = function;
+  self->context = context;
+  self->jobs_total = number_of_jobs;
+  self->jobs_done = 0U;
+  self->jobs_failed = 0U;
+  self->frames = 0U;
+  self->audio_seconds = 0.;
+
+  // Jobs are striped so every worker starts on the earliest ones
+  for (uint32_t i = 0U; i < self->number_of_workers; i++) {
+    RenderDeque *deque = &self->workers[i].deque;
+    free(deque->jobs);
+    deque->jobs = (uint32_t *)calloc(
+        number_of_jobs / self->number_of_workers + 1U, sizeof(uint32_t));
+    deque->head = 0U;
+    deque->tail = 0U;
+    if (!deque->jobs) {
+      return number_of_jobs;
+    }
+  }
+
+  for (uint32_t job = 0U; job < number_of_jobs; job++) {
+    RenderDeque *deque = &self->workers[job % self->number_of_workers].deque;
+    deque->jobs[deque->tail++] = job;
+  }
+
+  fegetenv(&self->environment);
+  const double start = get_time();
+
+  uint32_t started = 0U;
+  for (; started < self->number_of_workers; started++) {
+    if (pthread_create(&self->workers[started].thread, NULL, render_jobs_work,
+                       &self->workers[started]) != 0) {
+      break;
+    }
+  }
+
+  // The calling thread drains the deques of the workers that couldn't
+  // start, all of them when no thread could be created
+  for (uint32_t i = started; i < self->number_of_workers; i++) {
+    render_jobs_work(&self->workers[i]);
+  }
+
+  render_jobs_wait(self, start);
+
+  for (uint32_t i = 0U; i < started; i++) {
+    pthread_join(self->workers[i].thread, NULL);
+  }
+
+  return self->jobs_failed;
+}
+
+// A job bigger than the whole budget still runs, just alone
+void render_jobs_reserve(RenderJobs *self, const size_t bytes) {
+  pthread_mutex_lock(&self->lock);
+
+  while (self->memory_budget > 0U && self->jobs_running > 0U &&
+         self->memory_in_use + bytes > self->memory_budget) {
+    pthread_cond_wait(&self->changed, &self->lock);
+  }
+
+  self->memory_in_use += bytes;
+  self->jobs_running++;
+
+  pthread_mutex_unlock(&self->lock);
+}
+
+void render_jobs_release(RenderJobs *self, const size_t bytes) {
+  pthread_mutex_lock(&self->lock);
+
+  self->memory_in_use -= bytes;
+  self->jobs_running--;
+  pthread_cond_broadcast(&self->changed);
+
+  pthread_mutex_unlock(&self->lock);
+}
+
+void render_jobs_report(RenderJobs *self, const uint64_t frames,
+                        const uint32_t sample_rate) {
+  pthread_mutex_lock(&self->lock);
+
+  self->frames += frames;
+  self->audio_seconds += (double)frames / (double)sample_rate;
+
+  pthread_mutex_unlock(&self->lock);
+}
@@ -0,0 +1,54 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef RENDER_JOBS_H
+#define RENDER_JOBS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Runs independent jobs on a pool of workers. Every worker owns a deque of
+ * jobs and steals from the others once its own runs out. Jobs reserve their
+ * memory from a shared budget before they start, and report processed audio
+ * so throughput can be shown while they run.
+ *
+ * In deterministic mode jobs are striped over the workers in order and never
+ * stolen, and every worker runs with the floating point environment of the
+ * calling thread.
+ */
+typedef struct RenderJobs RenderJobs;
+
+typedef bool (*RenderJobFunction)(void *context, uint32_t job);
+
+RenderJobs *render_jobs_initialize(uint32_t number_of_workers,
+                                   bool deterministic, size_t memory_budget,
+                                   bool progress);
+void render_jobs_free(RenderJobs *self);
+uint32_t render_jobs_run(RenderJobs *self, uint32_t number_of_jobs,
+                         RenderJobFunction function, void *context);
+void render_jobs_reserve(RenderJobs *self, size_t bytes);
+void render_jobs_release(RenderJobs *self, size_t bytes);
+void render_jobs_report(RenderJobs *self, uint64_t frames,
+                        uint32_t sample_rate);
+uint32_t render_jobs_get_default_workers(void);
+
+#endif
@@ -0,0 +1,228 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "render_pipeline.h"
+#include "../src/spsc_ring.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PIPELINE_BLOCKS 4U
+#define PIPELINE_BLOCK_FRAMES 65536U
+#define PIPELINE_ALIGNMENT 64U
+#define PIPELINE_END UINT32_MAX
+#define SPIN_ATTEMPTS 64U
+#define IDLE_SLEEP_NS 100000L
+
+typedef struct RenderBlock {
+  float *samples;
+  uint32_t frames;
+  uint32_t first;
+  uint32_t count;
+} RenderBlock;
+
+typedef struct RenderPipeline {
+  RenderPipelineStages stages;
+  uint32_t channels;
+  RenderBlock blocks[PIPELINE_BLOCKS];
+
+  SpscRing *empty;     // Writer to reader
+  SpscRing *filled;    // Reader to DSP
+  SpscRing *processed; // DSP to writer
+  bool failed;
+} RenderPipeline;
+
+size_t render_pipeline_estimate_memory(const uint32_t channels) {
+  return sizeof(float) * PIPELINE_BLOCKS * PIPELINE_BLOCK_FRAMES * channels;
+}
+
+// Stages wait on disk most of the time, so after a short spin they sleep
+static void render_pipeline_pop(SpscRing *ring, uint32_t *block) {
+  for (uint32_t attempt = 0U; !spsc_ring_pop(ring, block); attempt++) {
+    if (attempt < SPIN_ATTEMPTS) {
+      sched_yield();
+    } else {
+      const struct timespec idle = {0, IDLE_SLEEP_NS};
+      nanosleep(&idle, NULL);
+    }
+  }
+}
+
+// Every ring holds all the blocks and the end marker, pushes can't fail
+static void render_pipeline_push(SpscRing *ring, const uint32_t block) {
+  spsc_ring_push(ring, &block);
+}
+
+static void *render_pipeline_read(void *data) {
+  RenderPipeline *self = (RenderPipeline *)data;
+  uint32_t index = 0U;
+
+  while (!__atomic_load_n(&self->failed, __ATOMIC_ACQUIRE)) {
+    render_pipeline_pop(self->empty, &index);
+
+    RenderBlock *block = &self->blocks[index];
+    block->frames = self->stages.read(self->stages.context, block->samples,
+                                      PIPELINE_BLOCK_FRAMES);
+    if (block->frames == 0U) {
+      break;
+    }
+
+    render_pipeline_push(self->filled, index);
+  }
+
+  render_pipeline_push(self->filled, PIPELINE_END);
+  return NULL;
+}
+
+// After a failed write the writer keeps draining, so no stage waits forever
+static void *render_pipeline_write(void *data) {
+  RenderPipeline *self = (RenderPipeline *)data;
+  uint32_t index = 0U;
+
+  for (;;) {
+    render_pipeline_pop(self->processed, &index);
+    if (index == PIPELINE_END) {
+      break;
+    }
+
+    const RenderBlock *block = &self->blocks[index];
+    if (block->count > 0U &&
+        !__atomic_load_n(&self->failed, __ATOMIC_ACQUIRE) &&
+        !self->stages.write(
+            self->stages.context,
+            &block->samples[(size_t)block->first * self->channels],
+            block->count)) {
+      __atomic_store_n(&self->failed, true, __ATOMIC_RELEASE);
+    }
+
+    render_pipeline_push(self->empty, index);
+  }
+
+  return NULL;
+}
+
+static void render_pipeline_free(RenderPipeline *self) {
+  for (uint32_t i = 0U; i < PIPELINE_BLOCKS; i++) {
+    free(self->blocks[i].samples);
+  }
+
+  if (self->empty) {
+    spsc_ring_free(self->empty);
+  }
+  if (self->filled) {
+    spsc_ring_free(self->filled);
+  }
+  if (self->processed) {
+    spsc_ring_free(self->processed);
+  }
+}
+
+static bool render_pipeline_initialize(RenderPipeline *self,
+                                       const uint32_t channels,
+                                       const RenderPipelineStages stages) {
+  memset(self, 0, sizeof(RenderPipeline));
+  self->stages = stages;
+  self->channels = channels;
+
+  self->empty = spsc_ring_initialize(PIPELINE_BLOCKS + 1U, sizeof(uint32_t));
+  self->filled = spsc_ring_initialize(PIPELINE_BLOCKS + 1U, sizeof(uint32_t));
+  self->processed =
+      spsc_ring_initialize(PIPELINE_BLOCKS + 1U, sizeof(uint32_t));
+  if (!self->empty || !self->filled || !self->processed) {
+    render_pipeline_free(self);
+    return false;
+  }
+
+  // Large aligned blocks keep the reads and writes of libsndfile long
+  for (uint32_t i = 0U; i < PIPELINE_BLOCKS; i++) {
+    void *samples = NULL;
+    if (posix_memalign(&samples, PIPELINE_ALIGNMENT,
+                       sizeof(float) * PIPELINE_BLOCK_FRAMES * channels) !=
+        0) {
+      render_pipeline_free(self);
+      return false;
+    }
+
+    self->blocks[i].samples = (float *)samples;
+    render_pipeline_push(self->empty, i);
+  }
+
+  return true;
+}
+
+bool render_pipeline_run(const uint32_t channels,
+                         const RenderPipelineStages stages) {
+  RenderPipeline self;
+  if (!render_pipeline_initialize(&self, channels, stages)) {
+    return false;
+  }
+
+  pthread_t reader;
+  pthread_t writer;
+
+  if (pthread_create(&reader, NULL, render_pipeline_read, &self) != 0) {
+    render_pipeline_free(&self);
+    return false;
+  }
+
+  if (pthread_create(&writer, NULL, render_pipeline_write, &self) != 0) {
+    // Hand the blocks back until the reader notices and stops
+    __atomic_store_n(&self.failed, true, __ATOMIC_RELEASE);
+    uint32_t index = 0U;
+    do {
+      render_pipeline_pop(self.filled, &index);
+      if (index != PIPELINE_END) {
+        render_pipeline_push(self.empty, index);
+      }
+    } while (index != PIPELINE_END);
+    pthread_join(reader, NULL);
+    render_pipeline_free(&self);
+    return false;
+  }
+
+  uint32_t index = 0U;
+  for (;;) {
+    render_pipeline_pop(self.filled, &index);
+    if (index == PIPELINE_END) {
+      break;
+    }
+
+    RenderBlock *block = &self.blocks[index];
+    block->first = 0U;
+    block->count = self.stages.process(self.stages.context, block->samples,
+                                       block->frames, &block->first);
+
+    render_pipeline_push(self.processed, index);
+  }
+
+  render_pipeline_push(self.processed, PIPELINE_END);
+
+  pthread_join(reader, NULL);
+  pthread_join(writer, NULL);
+
+  const bool succeeded = !self.failed;
+  render_pipeline_free(&self);
+
+  return succeeded;
+}
@@ -0,0 +1,54 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef RENDER_PIPELINE_H
+#define RENDER_PIPELINE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Overlaps disk and DSP work of one render. A reader thread fills blocks of
+ * interleaved frames, the calling thread processes them in place and a
+ * writer thread stores them. Blocks travel between the stages through lock
+ * free single producer single consumer rings.
+ *
+ * read returns the frames it put in the block, zero at the end. process
+ * returns how many frames to write, starting at *first.
+ */
+typedef uint32_t (*RenderReadFunction)(void *context, float *block,
+                                       uint32_t frames);
+typedef uint32_t (*RenderProcessFunction)(void *context, float *block,
+                                          uint32_t frames, uint32_t *first);
+typedef bool (*RenderWriteFunction)(void *context, const float *block,
+                                    uint32_t frames);
+
+typedef struct RenderPipelineStages {
+  RenderReadFunction read;
+  RenderProcessFunction process;
+  RenderWriteFunction write;
+  void *context;
+} RenderPipelineStages;
+
+size_t render_pipeline_estimate_memory(uint32_t channels);
+bool render_pipeline_run(uint32_t channels, RenderPipelineStages stages);
+
+#endif
@@ -0,0 +1,496 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "render_plugin.h"
+#include "../src/quality_governor.h"
+#include "lv2/core/lv2.h"
+#include "lv2/log/log.h"
+#include "lv2/state/state.h"
+#include "lv2/urid/urid.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Both plugins export lv2_descriptor, the build renames them
+const LV2_Descriptor *nrepellent_lv2_descriptor(uint32_t index);
+const LV2_Descriptor *nrepellent_adaptive_lv2_descriptor(uint32_t index);
+
+#define MAXIMUM_CONTROLS 16U
+
+// Rough per channel footprint of the plugins, only used to budget memory
+#define MANUAL_FRAME_MS 46U
+#define ADAPTIVE_FRAME_MS 36U
+#define SPECTRAL_BUFFERS 48U // STFT sized arrays held by libspecbleach
+#define MEDIAN_HISTOGRAM_ROWS 96U
+#define WARM_START_SECONDS 2U
+
+static pthread_mutex_t instance_lock = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct RenderControl {
+  const char *symbol;
+  float value;
+} RenderControl;
+
+// Control ports come first in both plugins, ordered by index. The latency
+// port follows them and then the audio ports. Controls added later, from the
+// leading count on, are appended after the audio ports and stereo instances
+// have one more control after those.
+// clang-format off
+static const RenderControl manual_controls[] = {
+    {"noise_learn", 0.F},
+    {"reduction", 10.F},
+    {"noise_scaling_type", 2.F},
+    {"offset", 2.F},
+    {"postfilter", -10.F},
+    {"smoothing", 0.F},
+    {"whitening", 0.F},
+    {"transient_protection", 0.F},
+    {"Residual_listen", 0.F},
+    {"reset_noise_profile", 0.F},
+    {"enable", 1.F},
+    {"noise_tracking", 0.F},
+};
+#define MANUAL_LEADING_CONTROLS 11U
+
+static const RenderControl adaptive_controls[] = {
+    {"reduction", 10.F},
+    {"noise_scaling_type", 2.F},
+    {"offset", 2.F},
+    {"postfilter", -10.F},
+    {"smoothing", 0.F},
+    {"whitening", 0.F},
+    {"Residual_listen", 0.F},
+    {"enable", 1.F},
+};
+#define ADAPTIVE_LEADING_CONTROLS 8U
+// clang-format on
+
+#define MID_SIDE_SYMBOL "mid_side"
+
+typedef struct RenderUnit {
+  const LV2_Descriptor *descriptor;
+  LV2_Handle handle;
+  uint32_t first_channel;
+  uint32_t channels;
+  float controls[MAXIMUM_CONTROLS];
+  float latency;
+  float mid_side;
+  float quality;
+} RenderUnit;
+
+struct RenderPlugin {
+  const RenderControl *controls;
+  uint32_t number_of_controls;
+  uint32_t number_of_leading_controls;
+
+  RenderUnit *units;
+  uint32_t number_of_units;
+
+  char **uris;
+  uint32_t number_of_uris;
+  uint32_t uris_capacity;
+  LV2_URID log_error;
+  LV2_URID log_warning;
+
+  LV2_URID_Map map;
+  LV2_Log_Log log;
+  LV2_Feature map_feature;
+  LV2_Feature log_feature;
+  LV2_Feature offline_feature;
+  const LV2_Feature *features[4];
+};
+
+typedef struct RenderStateContext {
+  RenderPlugin *self;
+  RenderState *state;
+  const RenderState *saved;
+  uint32_t unit;
+} RenderStateContext;
+
+static void render_plugin_get_controls(const RenderPluginType type,
+                                       const RenderControl **controls,
+                                       uint32_t *number_of_controls,
+                                       uint32_t *number_of_leading_controls) {
+  if (type == RENDER_PLUGIN_ADAPTIVE) {
+    *controls = adaptive_controls;
+    *number_of_controls =
+        (uint32_t)(sizeof(adaptive_controls) / sizeof(RenderControl));
+    *number_of_leading_controls = ADAPTIVE_LEADING_CONTROLS;
+  } else {
+    *controls = manual_controls;
+    *number_of_controls =
+        (uint32_t)(sizeof(manual_controls) / sizeof(RenderControl));
+    *number_of_leading_controls = MANUAL_LEADING_CONTROLS;
+  }
+}
+
+// Port of the k-th control, either before the latency port or after the
+// audio ports of the instance
+static uint32_t get_control_port(const RenderPlugin *self, const uint32_t k,
+                                 const uint32_t channels) {
+  return k < self->number_of_leading_controls ? k : k + 1U + 2U * channels;
+}
+
+// Every instance gets its own URID table, so renders on different threads
+// never share it
+static LV2_URID map_uri(LV2_URID_Map_Handle handle, const char *uri) {
+  RenderPlugin *self = (RenderPlugin *)handle;
+
+  for (uint32_t i = 0U; i < self->number_of_uris; i++) {
+    if (!strcmp(self->uris[i], uri)) {
+      return i + 1U;
+    }
+  }
+
+  if (self->number_of_uris == self->uris_capacity) {
+    const uint32_t capacity =
+        self->uris_capacity ? self->uris_capacity * 2U : 32U;
+    char **uris = (char **)realloc(self->uris, sizeof(char *) * capacity);
+    if (!uris) {
+      return 0U;
+    }
+    self->uris = uris;
+    self->uris_capacity = capacity;
+  }
+
+  char *copy = (char *)calloc(strlen(uri) + 1U, sizeof(char));
+  if (!copy) {
+    return 0U;
+  }
+  strcpy(copy, uri);
+
+  self->uris[self->number_of_uris++] = copy;
+  return self->number_of_uris;
+}
+
+static const char *unmap_uri(const RenderPlugin *self, const LV2_URID urid) {
+  return urid > 0U && urid <= self->number_of_uris ? self->uris[urid - 1U]
+                                                   : NULL;
+}
+
+// Only errors and warnings reach the console, notes would repeat per file
+static int log_vprintf(LV2_Log_Handle handle, LV2_URID type, const char *fmt,
+                       va_list ap) {
+  const RenderPlugin *self = (const RenderPlugin *)handle;
+
+  if (type != self->log_error && type != self->log_warning) {
+    return 0;
+  }
+
+  return vfprintf(stderr, fmt, ap);
+}
+
+static int log_printf(LV2_Log_Handle handle, LV2_URID type, const char *fmt,
+                      ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  const int written = log_vprintf(handle, type, fmt, ap);
+  va_end(ap);
+  return written;
+}
+
+bool render_plugin_has_control(const RenderPluginType type,
+                               const char *symbol) {
+  const RenderControl *controls = NULL;
+  uint32_t number_of_controls = 0U;
+  uint32_t number_of_leading_controls = 0U;
+  render_plugin_get_controls(type, &controls, &number_of_controls,
+                             &number_of_leading_controls);
+
+  for (uint32_t i = 0U; i < number_of_controls; i++) {
+    if (!strcmp(controls[i].symbol, symbol)) {
+      return true;
+    }
+  }
+
+  return !strcmp(symbol, MID_SIDE_SYMBOL);
+}
+
+size_t render_plugin_estimate_memory(const RenderPluginType type,
+                                     const uint32_t sample_rate,
+                                     const uint32_t channels) {
+  const size_t frame =
+      (size_t)sample_rate *
+      (type == RENDER_PLUGIN_ADAPTIVE ? ADAPTIVE_FRAME_MS : MANUAL_FRAME_MS) /
+      1000U;
+
+  size_t floats = frame * SPECTRAL_BUFFERS;
+  if (type == RENDER_PLUGIN_ADAPTIVE) {
+    floats += (size_t)sample_rate * WARM_START_SECONDS;
+  } else {
+    floats += frame * MEDIAN_HISTOGRAM_ROWS;
+  }
+
+  return sizeof(RenderPlugin) + channels * (sizeof(RenderUnit) +
+                                            floats * sizeof(float));
+}
+
+RenderPlugin *render_plugin_initialize(const RenderPluginType type,
+                                       const uint32_t sample_rate,
+                                       const uint32_t channels) {
+  if (channels == 0U) {
+    return NULL;
+  }
+
+  RenderPlugin *self = (RenderPlugin *)calloc(1U, sizeof(RenderPlugin));
+  if (!self) {
+    return NULL;
+  }
+
+  render_plugin_get_controls(type, &self->controls, &self->number_of_controls,
+                             &self->number_of_leading_controls);
+
+  self->map.handle = self;
+  self->map.map = map_uri;
+  self->log.handle = self;
+  self->log.printf = log_printf;
+  self->log.vprintf = log_vprintf;
+  self->map_feature.URI = LV2_URID__map;
+  self->map_feature.data = &self->map;
+  self->log_feature.URI = LV2_LOG__log;
+  self->log_feature.data = &self->log;
+  self->offline_feature.URI = QUALITY_GOVERNOR_OFFLINE_URI;
+  self->offline_feature.data = NULL;
+  self->features[0] = &self->map_feature;
+  self->features[1] = &self->log_feature;
+  self->features[2] = &self->offline_feature;
+  self->features[3] = NULL;
+
+  self->log_error = map_uri(self, LV2_LOG__Error);
+  self->log_warning = map_uri(self, LV2_LOG__Warning);
+
+  self->number_of_units = channels == 2U ? 1U : channels;
+  self->units = (RenderUnit *)calloc(self->number_of_units, sizeof(RenderUnit));
+  if (!self->units) {
+    render_plugin_free(self);
+    return NULL;
+  }
+
+  const LV2_Descriptor *descriptor =
+      type == RENDER_PLUGIN_ADAPTIVE
+          ? nrepellent_adaptive_lv2_descriptor(channels == 2U ? 1U : 0U)
+          : nrepellent_lv2_descriptor(channels == 2U ? 1U : 0U);
+
+  for (uint32_t i = 0U; i < self->number_of_units; i++) {
+    RenderUnit *unit = &self->units[i];
+
+    unit->descriptor = descriptor;
+    unit->channels = channels == 2U ? 2U : 1U;
+    unit->first_channel = i;
+
+    pthread_mutex_lock(&instance_lock);
+    unit->handle = descriptor->instantiate(descriptor, (double)sample_rate,
+                                           "", self->features);
+    pthread_mutex_unlock(&instance_lock);
+
+    if (!unit->handle) {
+      render_plugin_free(self);
+      return NULL;
+    }
+
+    for (uint32_t k = 0U; k < self->number_of_controls; k++) {
+      unit->controls[k] = self->controls[k].value;
+      descriptor->connect_port(unit->handle,
+                               get_control_port(self, k, unit->channels),
+                               &unit->controls[k]);
+    }
+    descriptor->connect_port(unit->handle, self->number_of_leading_controls,
+                             &unit->latency);
+
+    // After the appended controls
+    const uint32_t toggle_port =
+        self->number_of_controls + 1U + 2U * unit->channels;
+    if (unit->channels == 2U) {
+      descriptor->connect_port(unit->handle, toggle_port, &unit->mid_side);
+    }
+    descriptor->connect_port(unit->handle,
+                             toggle_port + (unit->channels == 2U ? 1U : 0U),
+                             &unit->quality);
+
+    if (descriptor->activate) {
+      descriptor->activate(unit->handle);
+    }
+  }
+
+  return self;
+}
+
+void render_plugin_free(RenderPlugin *self) {
+  for (uint32_t i = 0U; self->units && i < self->number_of_units; i++) {
+    RenderUnit *unit = &self->units[i];
+    if (unit->handle) {
+      if (unit->descriptor->deactivate) {
+        unit->descriptor->deactivate(unit->handle);
+      }
+
+      pthread_mutex_lock(&instance_lock);
+      unit->descriptor->cleanup(unit->handle);
+      pthread_mutex_unlock(&instance_lock);
+    }
+  }
+
+  for (uint32_t i = 0U; i < self->number_of_uris; i++) {
+    free(self->uris[i]);
+  }
+
+  free(self->uris);
+  free(self->units);
+  free(self);
+}
+
+bool render_plugin_set_control(RenderPlugin *self, const char *symbol,
+                               const float value) {
+  for (uint32_t k = 0U; k < self->number_of_controls; k++) {
+    if (!strcmp(self->controls[k].symbol, symbol)) {
+      for (uint32_t i = 0U; i < self->number_of_units; i++) {
+        self->units[i].controls[k] = value;
+      }
+      return true;
+    }
+  }
+
+  // Only stereo instances read it, mono ones ignore it
+  if (!strcmp(symbol, MID_SIDE_SYMBOL)) {
+    for (uint32_t i = 0U; i < self->number_of_units; i++) {
+      self->units[i].mid_side = value;
+    }
+    return true;
+  }
+
+  return false;
+}
+
+uint32_t render_plugin_get_latency(const RenderPlugin *self) {
+  return (uint32_t)self->units[0].latency;
+}
+
+void render_plugin_process(RenderPlugin *self,
+                           const uint32_t number_of_samples,
+                           const float *const *input, float *const *output) {
+  const uint32_t audio_port = self->number_of_leading_controls + 1U;
+
+  for (uint32_t i = 0U; i < self->number_of_units; i++) {
+    RenderUnit *unit = &self->units[i];
+
+    for (uint32_t c = 0U; c < unit->channels; c++) {
+      const uint32_t channel = unit->first_channel + c;
+      unit->descriptor->connect_port(unit->handle, audio_port + 2U * c,
+                                     (void *)input[channel]);
+      unit->descriptor->connect_port(unit->handle, audio_port + 2U * c + 1U,
+                                     output[channel]);
+    }
+
+    unit->descriptor->run(unit->handle, number_of_samples);
+  }
+}
+
+static LV2_State_Status store_property(LV2_State_Handle handle, uint32_t key,
+                                       const void *value, size_t size,
+                                       uint32_t type, uint32_t flags) {
+  RenderStateContext *context = (RenderStateContext *)handle;
+  const char *key_uri = unmap_uri(context->self, key);
+  const char *type_uri = unmap_uri(context->self, type);
+
+  if (!key_uri || !type_uri ||
+      !render_state_set(context->state, context->unit, key_uri, type_uri,
+                        flags, value, size)) {
+    return LV2_STATE_ERR_UNKNOWN;
+  }
+
+  return LV2_STATE_SUCCESS;
+}
+
+// A state saved from a single instance is shared by all of them, so a
+// profile learned on a mono file applies to every channel of a wider one
+static const void *retrieve_property(LV2_State_Handle handle, uint32_t key,
+                                     size_t *size, uint32_t *type,
+                                     uint32_t *flags) {
+  RenderStateContext *context = (RenderStateContext *)handle;
+  const char *key_uri = unmap_uri(context->self, key);
+  const char *type_uri = NULL;
+
+  if (!key_uri) {
+    return NULL;
+  }
+
+  const void *value = render_state_get(context->saved, context->unit,
+                                       key_uri, &type_uri, flags, size);
+  if (!value) {
+    value = render_state_get(context->saved, 0U, key_uri, &type_uri, flags,
+                             size);
+  }
+
+  if (value) {
+    *type = map_uri(context->self, type_uri);
+  }
+
+  return value;
+}
+
+static const LV2_State_Interface *
+render_plugin_get_state_interface(const RenderUnit *unit) {
+  if (!unit->descriptor->extension_data) {
+    return NULL;
+  }
+
+  return (const LV2_State_Interface *)unit->descriptor->extension_data(
+      LV2_STATE__interface);
+}
+
+bool render_plugin_save_state(RenderPlugin *self, RenderState *state) {
+  for (uint32_t i = 0U; i < self->number_of_units; i++) {
+    const LV2_State_Interface *interface =
+        render_plugin_get_state_interface(&self->units[i]);
+    if (!interface) {
+      return false;
+    }
+
+    RenderStateContext context = {self, state, NULL, i};
+    if (interface->save(self->units[i].handle, store_property, &context,
+                        LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE,
+                        NULL) != LV2_STATE_SUCCESS) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool render_plugin_restore_state(RenderPlugin *self,
+                                 const RenderState *state) {
+  for (uint32_t i = 0U; i < self->number_of_units; i++) {
+    const LV2_State_Interface *interface =
+        render_plugin_get_state_interface(&self->units[i]);
+    if (!interface) {
+      return false;
+    }
+
+    RenderStateContext context = {self, NULL, state, i};
+    if (interface->restore(self->units[i].handle, retrieve_property, &context,
+                           LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE,
+                           NULL) != LV2_STATE_SUCCESS) {
+      return false;
+    }
+  }
+
+  return true;
+}
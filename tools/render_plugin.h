@@ -0,0 +1,58 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef RENDER_PLUGIN_H
+#define RENDER_PLUGIN_H
+
+#include "render_state.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum RenderPluginType {
+  RENDER_PLUGIN_MANUAL = 0,
+  RENDER_PLUGIN_ADAPTIVE = 1,
+} RenderPluginType;
+
+/*
+ * Hosts the plugins linked into the executable. One or two channels use the
+ * mono or stereo descriptor, anything wider gets a mono instance per channel.
+ * Control values are kept in sync with the ttl files by symbol. Instances
+ * can live on different threads, creating and freeing them is serialized
+ * because the FFT planner underneath is not thread safe.
+ */
+typedef struct RenderPlugin RenderPlugin;
+
+RenderPlugin *render_plugin_initialize(RenderPluginType type,
+                                       uint32_t sample_rate,
+                                       uint32_t channels);
+void render_plugin_free(RenderPlugin *self);
+bool render_plugin_set_control(RenderPlugin *self, const char *symbol,
+                               float value);
+bool render_plugin_has_control(RenderPluginType type, const char *symbol);
+size_t render_plugin_estimate_memory(RenderPluginType type,
+                                     uint32_t sample_rate, uint32_t channels);
+uint32_t render_plugin_get_latency(const RenderPlugin *self);
+void render_plugin_process(RenderPlugin *self, uint32_t number_of_samples,
+                           const float *const *input, float *const *output);
+bool render_plugin_save_state(RenderPlugin *self, RenderState *state);
+bool render_plugin_restore_state(RenderPlugin *self, const RenderState *state);
+
+#endif
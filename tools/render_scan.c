@@ -0,0 +1,160 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "render_scan.h"
+#include "../src/simd_kernels.h"
+#include <float.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#define SILENCE_DB -120.F // Digital silence says nothing about the noise
+
+typedef struct RenderScanCandidate {
+  float score;
+  uint32_t window;
+} RenderScanCandidate;
+
+static double to_decibels(const double power) {
+  return 10. * log10(power + (double)FLT_MIN);
+}
+
+// The first difference is a one pole high pass, so its share of the energy
+// follows the spectral tilt without a transform
+float render_scan_score(const float *interleaved, const uint32_t channels,
+                        const uint32_t number_of_frames,
+                        const uint32_t subframe_length) {
+  const SimdKernels *kernels = simd_kernels_get();
+  const size_t length = (size_t)subframe_length * channels;
+
+  uint32_t count = 0U;
+  double energy = 0.;
+  double level_sum = 0.;
+  double level_squares = 0.;
+  double tilt_sum = 0.;
+  double tilt_squares = 0.;
+
+  for (uint32_t start = 0U; start + subframe_length <= number_of_frames;
+       start += subframe_length) {
+    const float *samples = &interleaved[(size_t)start * channels];
+
+    const float subframe_energy = kernels->sum_of_squares(samples, length);
+    float difference_energy = 0.F;
+    for (size_t k = channels; k < length; k++) {
+      const float difference = samples[k] - samples[k - channels];
+      difference_energy += difference * difference;
+    }
+
+    const double level = to_decibels((double)subframe_energy / (double)length);
+    const double tilt = to_decibels((double)difference_energy) -
+                        to_decibels((double)subframe_energy);
+
+    energy += (double)subframe_energy;
+    level_sum += level;
+    level_squares += level * level;
+    tilt_sum += tilt;
+    tilt_squares += tilt * tilt;
+    count++;
+  }
+
+  if (count == 0U) {
+    return INFINITY;
+  }
+
+  const double mean_level = to_decibels(energy / ((double)length * count));
+  if (mean_level < (double)SILENCE_DB) {
+    return INFINITY;
+  }
+
+  const double level_mean = level_sum / count;
+  const double tilt_mean = tilt_sum / count;
+  const double level_spread =
+      sqrt(fmax(level_squares / count - level_mean * level_mean, 0.));
+  const double tilt_spread =
+      sqrt(fmax(tilt_squares / count - tilt_mean * tilt_mean, 0.));
+
+  return (float)(mean_level + level_spread + tilt_spread);
+}
+
+static int compare_candidates(const void *a, const void *b) {
+  const RenderScanCandidate *first = (const RenderScanCandidate *)a;
+  const RenderScanCandidate *second = (const RenderScanCandidate *)b;
+
+  if (first->score != second->score) {
+    return first->score < second->score ? -1 : 1;
+  }
+  return first->window < second->window ? -1 : 1;
+}
+
+static int compare_windows(const void *a, const void *b) {
+  const RenderScanCandidate *first = (const RenderScanCandidate *)a;
+  const RenderScanCandidate *second = (const RenderScanCandidate *)b;
+
+  return first->window < second->window ? -1 : 1;
+}
+
+// Picks the wanted lowest scoring windows and merges the adjacent ones, so
+// ranges can hold at most wanted entries. Returns the number of ranges.
+uint32_t render_scan_select(const float *scores,
+                            const uint32_t number_of_windows,
+                            const uint32_t wanted, RenderScanRange *ranges) {
+  RenderScanCandidate *candidates = (RenderScanCandidate *)calloc(
+      number_of_windows, sizeof(RenderScanCandidate));
+  if (!candidates) {
+    return 0U;
+  }
+
+  uint32_t number_of_candidates = 0U;
+  for (uint32_t i = 0U; i < number_of_windows; i++) {
+    if (isfinite(scores[i])) {
+      candidates[number_of_candidates].score = scores[i];
+      candidates[number_of_candidates].window = i;
+      number_of_candidates++;
+    }
+  }
+
+  qsort(candidates, number_of_candidates, sizeof(RenderScanCandidate),
+        compare_candidates);
+
+  // Learning runs through the chosen windows in the order they were recorded
+  const uint32_t chosen =
+      number_of_candidates < wanted ? number_of_candidates : wanted;
+  qsort(candidates, chosen, sizeof(RenderScanCandidate), compare_windows);
+
+  uint32_t number_of_ranges = 0U;
+  for (uint32_t i = 0U; i < chosen; i++) {
+    const uint32_t window = candidates[i].window;
+
+    if (number_of_ranges > 0U &&
+        ranges[number_of_ranges - 1U].first_window +
+                ranges[number_of_ranges - 1U].number_of_windows ==
+            window) {
+      ranges[number_of_ranges - 1U].number_of_windows++;
+    } else {
+      ranges[number_of_ranges].first_window = window;
+      ranges[number_of_ranges].number_of_windows = 1U;
+      number_of_ranges++;
+    }
+  }
+
+  free(candidates);
+
+  return number_of_ranges;
+}
@@ -0,0 +1,43 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef RENDER_SCAN_H
+#define RENDER_SCAN_H
+
+#include <stdint.h>
+
+/*
+ * First pass of the automatic profile learning. Fixed windows of a file are
+ * scored by level and by how steady their level and spectral tilt stay, so
+ * the lowest scores point at the stretches most likely to be only noise.
+ * Windows are scored independently, which lets a file be scanned in
+ * parallel chunks.
+ */
+typedef struct RenderScanRange {
+  uint32_t first_window;
+  uint32_t number_of_windows;
+} RenderScanRange;
+
+float render_scan_score(const float *interleaved, uint32_t channels,
+                        uint32_t number_of_frames, uint32_t subframe_length);
+uint32_t render_scan_select(const float *scores, uint32_t number_of_windows,
+                            uint32_t wanted, RenderScanRange *ranges);
+
+#endif
@@ -0,0 +1,241 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "render_state.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STATE_FILE_MAGIC "NRSTATE1"
+
+typedef struct RenderStateProperty {
+  uint32_t instance;
+  char *key;
+  char *type;
+  uint32_t flags;
+  size_t size;
+  void *value;
+} RenderStateProperty;
+
+struct RenderState {
+  RenderStateProperty *properties;
+  uint32_t count;
+  uint32_t capacity;
+};
+
+static char *copy_string(const char *string) {
+  const size_t length = strlen(string) + 1U;
+  char *copy = (char *)malloc(length);
+  if (copy) {
+    memcpy(copy, string, length);
+  }
+  return copy;
+}
+
+RenderState *render_state_initialize(void) {
+  return (RenderState *)calloc(1U, sizeof(RenderState));
+}
+
+void render_state_free(RenderState *self) {
+  for (uint32_t i = 0U; i < self->count; i++) {
+    free(self->properties[i].key);
+    free(self->properties[i].type);
+    free(self->properties[i].value);
+  }
+  free(self->properties);
+  free(self);
+}
+
+static RenderStateProperty *render_state_find(const RenderState *self,
+                                              const uint32_t instance,
+                                              const char *key) {
+  for (uint32_t i = 0U; i < self->count; i++) {
+    if (self->properties[i].instance == instance &&
+        !strcmp(self->properties[i].key, key)) {
+      return &self->properties[i];
+    }
+  }
+  return NULL;
+}
+
+bool render_state_set(RenderState *self, const uint32_t instance,
+                      const char *key, const char *type, const uint32_t flags,
+                      const void *value, const size_t size) {
+  RenderStateProperty *property = render_state_find(self, instance, key);
+
+  if (!property) {
+    if (self->count == self->capacity) {
+      const uint32_t capacity = self->capacity ? self->capacity * 2U : 8U;
+      RenderStateProperty *properties = (RenderStateProperty *)realloc(
+          self->properties, sizeof(RenderStateProperty) * capacity);
+      if (!properties) {
+        return false;
+      }
+      self->properties = properties;
+      self->capacity = capacity;
+    }
+
+    property = &self->properties[self->count];
+    memset(property, 0, sizeof(RenderStateProperty));
+    property->instance = instance;
+    property->key = copy_string(key);
+    if (!property->key) {
+      return false;
+    }
+    self->count++;
+  }
+
+  char *type_copy = copy_string(type);
+  void *value_copy = malloc(size > 0U ? size : 1U);
+  if (!type_copy || !value_copy) {
+    free(type_copy);
+    free(value_copy);
+    return false;
+  }
+  memcpy(value_copy, value, size);
+
+  free(property->type);
+  free(property->value);
+  property->type = type_copy;
+  property->value = value_copy;
+  property->flags = flags;
+  property->size = size;
+
+  return true;
+}
+
+const void *render_state_get(const RenderState *self, const uint32_t instance,
+                             const char *key, const char **type,
+                             uint32_t *flags, size_t *size) {
+  const RenderStateProperty *property =
+      render_state_find(self, instance, key);
+  if (!property) {
+    return NULL;
+  }
+
+  *type = property->type;
+  *flags = property->flags;
+  *size = property->size;
+  return property->value;
+}
+
+static bool write_string(FILE *file, const char *string) {
+  const uint32_t length = (uint32_t)strlen(string);
+  return fwrite(&length, sizeof(uint32_t), 1U, file) == 1U &&
+         fwrite(string, 1U, length, file) == length;
+}
+
+static char *read_string(FILE *file) {
+  uint32_t length = 0U;
+  if (fread(&length, sizeof(uint32_t), 1U, file) != 1U) {
+    return NULL;
+  }
+
+  char *string = (char *)malloc((size_t)length + 1U);
+  if (!string) {
+    return NULL;
+  }
+
+  if (fread(string, 1U, length, file) != length) {
+    free(string);
+    return NULL;
+  }
+  string[length] = '\0';
+
+  return string;
+}
+
+// Values are written in the native byte order, the same way hosts keep
+// POD properties, so state files are meant for machines of the same kind
+bool render_state_save(const RenderState *self, const char *path) {
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    return false;
+  }
+
+  bool written = fwrite(STATE_FILE_MAGIC, 1U, 8U, file) == 8U &&
+                 fwrite(&self->count, sizeof(uint32_t), 1U, file) == 1U;
+
+  for (uint32_t i = 0U; written && i < self->count; i++) {
+    const RenderStateProperty *property = &self->properties[i];
+    const uint32_t size = (uint32_t)property->size;
+
+    written = fwrite(&property->instance, sizeof(uint32_t), 1U, file) == 1U &&
+              write_string(file, property->key) &&
+              write_string(file, property->type) &&
+              fwrite(&property->flags, sizeof(uint32_t), 1U, file) == 1U &&
+              fwrite(&size, sizeof(uint32_t), 1U, file) == 1U &&
+              fwrite(property->value, 1U, size, file) == size;
+  }
+
+  return fclose(file) == 0 && written;
+}
+
+RenderState *render_state_load(const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    return NULL;
+  }
+
+  char magic[8];
+  uint32_t count = 0U;
+  if (fread(magic, 1U, 8U, file) != 8U ||
+      memcmp(magic, STATE_FILE_MAGIC, 8U) != 0 ||
+      fread(&count, sizeof(uint32_t), 1U, file) != 1U) {
+    fclose(file);
+    return NULL;
+  }
+
+  RenderState *self = render_state_initialize();
+  bool valid = self != NULL;
+
+  for (uint32_t i = 0U; valid && i < count; i++) {
+    uint32_t instance = 0U;
+    uint32_t flags = 0U;
+    uint32_t size = 0U;
+    char *key = NULL;
+    char *type = NULL;
+    void *value = NULL;
+
+    valid = fread(&instance, sizeof(uint32_t), 1U, file) == 1U &&
+            (key = read_string(file)) != NULL &&
+            (type = read_string(file)) != NULL &&
+            fread(&flags, sizeof(uint32_t), 1U, file) == 1U &&
+            fread(&size, sizeof(uint32_t), 1U, file) == 1U &&
+            (value = malloc(size > 0U ? size : 1U)) != NULL &&
+            fread(value, 1U, size, file) == size &&
+            render_state_set(self, instance, key, type, flags, value, size);
+
+    free(key);
+    free(type);
+    free(value);
+  }
+
+  fclose(file);
+
+  if (!valid) {
+    if (self) {
+      render_state_free(self);
+    }
+    return NULL;
+  }
+
+  return self;
+}
@@ -0,0 +1,46 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef RENDER_STATE_H
+#define RENDER_STATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Plugin state kept outside of a host. Properties are stored by URI so a
+ * state saved by one instance can be restored into any other one, and it
+ * can be written to a file to reuse a learned noise profile across runs.
+ */
+typedef struct RenderState RenderState;
+
+RenderState *render_state_initialize(void);
+void render_state_free(RenderState *self);
+bool render_state_set(RenderState *self, uint32_t instance, const char *key,
+                      const char *type, uint32_t flags, const void *value,
+                      size_t size);
+const void *render_state_get(const RenderState *self, uint32_t instance,
+                             const char *key, const char **type,
+                             uint32_t *flags, size_t *size);
+bool render_state_save(const RenderState *self, const char *path);
+RenderState *render_state_load(const char *path);
+
+#endif